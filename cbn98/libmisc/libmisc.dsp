@@ -51,6 +51,10 @@ SOURCE=..\..\src\misc.c
 # End Source File
 # Begin Source File
 
+SOURCE=..\..\src\ode.c
+# End Source File
+# Begin Source File
+
 SOURCE=..\..\src\pgmplot.c
 # End Source File
 # Begin Source File
@@ -67,6 +71,14 @@ SOURCE=..\..\src\rawplot.c
 # End Source File
 # Begin Source File
 
+SOURCE=..\..\src\svgplot.c
+# End Source File
+# Begin Source File
+
+SOURCE=..\..\src\vecplot.c
+# End Source File
+# Begin Source File
+
 SOURCE=..\..\src\winplot.cpp
 # End Source File
 # End Target
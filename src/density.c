@@ -0,0 +1,155 @@
+
+/* NAME
+ *   density.c - plot how often a flow visits each pixel
+ * NOTES
+ *   This file is written in such a way that it should be included in
+ *   the other programs that need it, and not compiled directly.
+ *   Instead of drawing a trajectory as lines, it counts the number of
+ *   points of the trajectory that fall in each pixel and plots the
+ *   counts as gray levels, which shows how the attractor is weighted
+ *   as well as its shape.  Before including it, the program must have
+ *   the globals width, height, skip, points, delta, dt, factor, xx0,
+ *   yy0, zz0, xp, yp, method, tol, levels, threads, term, invert, and
+ *   mag, and must define odefunc() for the integrators in ode.c.
+ *   DENSITY_OPTIONS goes in the option table.
+ *
+ *   The points are divided among walkers, one for each of THREADS (or
+ *   every processor, if THREADS is zero).  Walker zero starts at (X0,
+ *   Y0, Z0), and the others a small random distance away, so each
+ *   follows its own trajectory.  Each walker skips SKIP points and
+ *   then counts its share of POINTS in a private array of counts, so
+ *   the walkers never wait for each other, and the arrays are added
+ *   up at the end.  The results only depend on the number of walkers.
+ *
+ *   The plot range is found as in the line plots, from a trajectory
+ *   over the skipped points.  The counts are mapped to gray levels
+ *   with -tone, which is one of "linear", "log", or "eq" (histogram
+ *   equalization).  See plot_counts() in plot.c.
+ */
+
+int density = 0;
+char *tone = "log";
+
+#define DENSITY_OPTIONS \
+  { "-density", OPT_SWITCH, &density, "Plot the density of points?" }, \
+  { "-tone",    OPT_STRING, &tone,    "linear, log, or eq." }
+
+void odefunc(double *s, double *ds);
+
+/* The variables (0, 1, or 2 for x, y, or z) and delays (0 or 1 times
+   DELTA) of the plotted coordinates, the number of walkers, and their
+   arrays of counts. */
+
+static int densvar[2], denslag[2], denswalkers;
+static unsigned int **denscount;
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+/* Set VAR and LAG from the -xp or -yp option STR. */
+
+static void density_coord(char *str, int *var, int *lag)
+{
+  if(strlen(str) < 4 || str[0] < 'x' || str[0] > 'z' ||
+     (strcmp(str + 1, "(t)") && strcmp(str + 1, "(t-delta)"))) {
+    fprintf(stderr, "Bad option passed to -xp or -yp: \"%s\"\n", str);
+    exit(1);
+  }
+  *var = str[0] - 'x';
+  *lag = (str[2] == 't' && str[3] == '-');
+}
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+/* Run walker W for SKIP points and then N more.  The N points are
+   counted in COUNT if it is not NULL, and the range of the skipped
+   points is kept in RANGE (as xmin, xmax, ymin, ymax) if it is not
+   NULL. */
+
+static void density_walk(int w, int n, unsigned int *count, double *range)
+{
+  RANDSTREAM rs;
+  ODE ode;
+  double s[3], *buf, px, py;
+  int i, j, si = 0, ssz = delta + 1;
+
+  s[0] = xx0; s[1] = yy0; s[2] = zz0;
+  if(w > 0) {
+    random_stream_init(&rs, 0, w);
+    for(j = 0; j < 3; j++)
+      s[j] += random_stream_range(&rs, -1e-3, 1e-3);
+  }
+  ode_init(&ode, 3, odefunc, s, dt, method, tol);
+  buf = xmalloc(sizeof(double) * 3 * ssz);
+
+  for(i = 0; i < skip + ssz + n; i++) {
+    ode_solve(&ode, (i + 1) * dt, s);
+    for(j = 0; j < 3; j++)
+      buf[3 * si + j] = s[j];
+    if(i >= delta) {
+      px = buf[3 * ((si + ssz - denslag[0] * delta) % ssz) + densvar[0]];
+      py = buf[3 * ((si + ssz - denslag[1] * delta) % ssz) + densvar[1]];
+      if(i < skip + ssz) {
+        if(range) {
+          range[0] = MIN(range[0], px); range[1] = MAX(range[1], px);
+          range[2] = MIN(range[2], py); range[3] = MAX(range[3], py);
+        }
+      }
+      else if(count)
+        plot_count(count, px, py);
+    }
+    si = (si + 1) % ssz;
+  }
+  free(buf);
+}
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+static void density_task(int w, void *arg)
+{
+  int n = points / denswalkers + (w < points % denswalkers);
+
+  density_walk(w, n, denscount[w], NULL);
+}
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+void density_plot(void)
+{
+  double range[4], temp;
+  int i, w, npix = width * height;
+
+  density_coord(xp, &densvar[0], &denslag[0]);
+  density_coord(yp, &densvar[1], &denslag[1]);
+
+  plot_mag = mag;
+  plot_inverse = invert;
+  plot_init(width, height, levels, term);
+
+  /* Find the range from the skipped points of walker zero. */
+  range[0] = range[2] = HUGE_VAL;
+  range[1] = range[3] = -HUGE_VAL;
+  density_walk(0, 0, NULL, range);
+  temp = (range[1] - range[0]) * factor; range[0] -= temp; range[1] += temp;
+  temp = (range[3] - range[2]) * factor; range[2] -= temp; range[3] += temp;
+  plot_set_range(range[0], range[1], range[2], range[3]);
+
+  denswalkers = (threads > 0) ? threads : parallel_threads(0);
+  denscount = xmalloc(sizeof(unsigned int *) * denswalkers);
+  for(w = 0; w < denswalkers; w++) {
+    denscount[w] = xmalloc(sizeof(unsigned int) * npix);
+    memset(denscount[w], 0, sizeof(unsigned int) * npix);
+  }
+  parallel_tasks(denswalkers, threads, density_task, NULL);
+
+  for(w = 1; w < denswalkers; w++) {
+    for(i = 0; i < npix; i++)
+      denscount[0][i] += denscount[w][i];
+    free(denscount[w]);
+  }
+  plot_counts(denscount[0], tone);
+  plot_finish();
+  free(denscount[0]);
+  free(denscount);
+}
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
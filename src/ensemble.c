@@ -0,0 +1,251 @@
+
+/* NAME
+ *   ensemble.c - integrate many trajectories of a flow at once
+ * NOTES
+ *   This file is written in such a way that it should be included in
+ *   the other programs that need it, and not compiled directly.  It
+ *   integrates an ensemble of trajectories of a three-dimensional
+ *   system side by side, with the same second-order Euler's method
+ *   that the programs use for a single trajectory.  Before including
+ *   it, the program must define FLOW(x, y, z, a, b, c, dx, dy, dz),
+ *   which sets the derivatives DX, DY, and DZ of one trajectory from
+ *   its state and its three parameters, and the globals dt, skip,
+ *   points, xx0, yy0, and zz0.  ENSEMBLE_OPTIONS goes at the end of
+ *   the program's option table.
+ *
+ *   The states and parameters of the members are kept in separate
+ *   arrays, one per variable, and are stepped in blocks of ENSBLOCK
+ *   members so that both stages of a step work on data that is still
+ *   in the cache.  The loops over a block have no calls or branches,
+ *   which lets the compiler vectorize them.
+ *
+ *   Member zero is the reference trajectory, and starts at (X0, Y0,
+ *   Z0).  The other members start there plus a Gaussian perturbation
+ *   of size EPS in every variable.  With -ensfile, the members are
+ *   instead read from a file with one member per line, given as an
+ *   initial state followed by up to three parameters; parameters
+ *   that are missing take the values on the command line.  A member
+ *   diverges at the first time that its distance from the reference
+ *   trajectory exceeds DIVERGE.
+ *
+ *   After SKIP steps, and then every EVERY steps, the ensemble is
+ *   written out as text.  With "-ensout stats", each line has the
+ *   time, the mean of each variable, the root mean squared distance
+ *   of the members from the mean, and the fraction of the members
+ *   that have diverged.  With "-ensout state", each line has the time,
+ *   a member number, and its state.  With "-ensout diverge", nothing
+ *   is written until the end, and then each line has a member number
+ *   and the time at which it diverged, or -1 if it never did.
+ */
+
+#include <math.h>
+
+#define ENSBLOCK 256
+
+int ens = 0, ensseed = 0, ensevery = 1;
+double enseps = 1e-6, diverge = 1.0;
+char *ensfile = NULL, *ensout = "stats";
+
+#define ENSEMBLE_OPTIONS \
+  { "-ens",     OPT_INT,    &ens,      "Number of ensemble members." }, \
+  { "-ensfile", OPT_STRING, &ensfile,  "File of ensemble members." }, \
+  { "-eps",     OPT_DOUBLE, &enseps,   "Size of ensemble perturbations." }, \
+  { "-seed",    OPT_INT,    &ensseed,  "Random seed for perturbations." }, \
+  { "-ensout",  OPT_STRING, &ensout,   "stats, state, or diverge." }, \
+  { "-every",   OPT_INT,    &ensevery, "Steps between ensemble output." }, \
+  { "-diverge", OPT_DOUBLE, &diverge,  "Distance at which members diverge." }
+
+/* An ensemble of N members, with their states, their parameters, and
+   the times at which they diverged (or -1). */
+
+typedef struct ENSEMBLE {
+  int n;
+  double *x, *y, *z, *a, *b, *c, *tdiv;
+} ENSEMBLE;
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+static void ensemble_alloc(ENSEMBLE *e, int n)
+{
+  e->n = n;
+  e->x = xmalloc(sizeof(double) * n);
+  e->y = xmalloc(sizeof(double) * n);
+  e->z = xmalloc(sizeof(double) * n);
+  e->a = xmalloc(sizeof(double) * n);
+  e->b = xmalloc(sizeof(double) * n);
+  e->c = xmalloc(sizeof(double) * n);
+  e->tdiv = xmalloc(sizeof(double) * n);
+}
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+/* Read the members from FNAME, with the parameters A, B, and C used
+   for any that a line leaves out. */
+
+static void ensemble_read(ENSEMBLE *e, char *fname,
+                          double a, double b, double c)
+{
+  FILE *fp;
+  char line[MAXSCANLINELEN];
+  double v[6];
+  int i, n, k;
+
+  if((fp = fopen(fname, "r")) == NULL) {
+    fprintf(stderr, "Cannot open ensemble file \"%s\".\n", fname);
+    exit(1);
+  }
+  for(n = 0; fgets(line, sizeof(line), fp); )
+    if(sscanf(line, "%lf %lf %lf", &v[0], &v[1], &v[2]) == 3) n++;
+  if(n == 0) {
+    fprintf(stderr, "No members in ensemble file \"%s\".\n", fname);
+    exit(1);
+  }
+  ensemble_alloc(e, n);
+  rewind(fp);
+  for(i = 0; i < n && fgets(line, sizeof(line), fp); ) {
+    v[3] = a; v[4] = b; v[5] = c;
+    k = sscanf(line, "%lf %lf %lf %lf %lf %lf",
+               &v[0], &v[1], &v[2], &v[3], &v[4], &v[5]);
+    if(k < 3) continue;
+    e->x[i] = v[0]; e->y[i] = v[1]; e->z[i] = v[2];
+    e->a[i] = v[3]; e->b[i] = v[4]; e->c[i] = v[5];
+    i++;
+  }
+  fclose(fp);
+}
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+/* Take one step of size DT for the M members of a block, whose states
+   and parameters start at X, Y, Z, A, B, and C. */
+
+static void ensemble_block(int m, double dt, double *x, double *y,
+                           double *z, double *a, double *b, double *c)
+{
+  double kx[ENSBLOCK], ky[ENSBLOCK], kz[ENSBLOCK];
+  double lx[ENSBLOCK], ly[ENSBLOCK], lz[ENSBLOCK];
+  double tx[ENSBLOCK], ty[ENSBLOCK], tz[ENSBLOCK];
+  double p[3][ENSBLOCK];
+  int i;
+
+  /* The parameters are copied so that the second loop, which writes
+   * the states, reads nothing else that the compiler would have to
+   * check for overlap with them before vectorizing.
+   */
+  for(i = 0; i < m; i++) {
+    p[0][i] = a[i]; p[1][i] = b[i]; p[2][i] = c[i];
+    FLOW(x[i], y[i], z[i], p[0][i], p[1][i], p[2][i],
+         kx[i], ky[i], kz[i]);
+    tx[i] = dt * kx[i] + x[i];
+    ty[i] = dt * ky[i] + y[i];
+    tz[i] = dt * kz[i] + z[i];
+  }
+  for(i = 0; i < m; i++) {
+    FLOW(tx[i], ty[i], tz[i], p[0][i], p[1][i], p[2][i],
+         lx[i], ly[i], lz[i]);
+    x[i] += 0.5 * dt * (kx[i] + lx[i]);
+    y[i] += 0.5 * dt * (ky[i] + ly[i]);
+    z[i] += 0.5 * dt * (kz[i] + lz[i]);
+  }
+}
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+/* Take one step of size DT that ends at time T, and note the members
+   that are newly more than sqrt(DIV2) from the reference. */
+
+static void ensemble_step(ENSEMBLE *e, double dt, double t, double div2)
+{
+  double *x, *y, *z, *tdiv, rx, ry, rz, d;
+  int i, s, m;
+
+  for(s = 0; s < e->n; s += ENSBLOCK) {
+    m = MIN(ENSBLOCK, e->n - s);
+    x = e->x + s; y = e->y + s; z = e->z + s;
+    tdiv = e->tdiv + s;
+    ensemble_block(m, dt, x, y, z, e->a + s, e->b + s, e->c + s);
+
+    /* The reference is in the first block, so it is always up to date
+     * by the time it is needed here.
+     */
+    rx = e->x[0]; ry = e->y[0]; rz = e->z[0];
+    for(i = 0; i < m; i++) {
+      d = (x[i] - rx) * (x[i] - rx) + (y[i] - ry) * (y[i] - ry) +
+        (z[i] - rz) * (z[i] - rz);
+      tdiv[i] = ((tdiv[i] < 0) & (d > div2)) ? t : tdiv[i];
+    }
+  }
+}
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+static void ensemble_stats(ENSEMBLE *e, double t)
+{
+  double mx = 0, my = 0, mz = 0, var = 0;
+  int i, ndiv = 0;
+
+  for(i = 0; i < e->n; i++) {
+    mx += e->x[i]; my += e->y[i]; mz += e->z[i];
+    ndiv += e->tdiv[i] >= 0;
+  }
+  mx /= e->n; my /= e->n; mz /= e->n;
+  for(i = 0; i < e->n; i++)
+    var += (e->x[i] - mx) * (e->x[i] - mx) +
+      (e->y[i] - my) * (e->y[i] - my) + (e->z[i] - mz) * (e->z[i] - mz);
+  printf("%g\t%g\t%g\t%g\t%g\t%g\n", t, mx, my, mz,
+         sqrt(var / e->n), (double) ndiv / e->n);
+}
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+/* Integrate the ensemble for SKIP + POINTS steps, with A, B, and C as
+   the parameters of the members that do not have their own. */
+
+void ensemble_run(double a, double b, double c)
+{
+  ENSEMBLE e;
+  int i, j, mode;
+
+  if(!strcmp(ensout, "stats")) mode = 0;
+  else if(!strcmp(ensout, "state")) mode = 1;
+  else if(!strcmp(ensout, "diverge")) mode = 2;
+  else {
+    fprintf(stderr, "Bad option passed to -ensout: \"%s\"\n", ensout);
+    exit(1);
+  }
+  if(ensevery < 1) ensevery = 1;
+
+  if(ensfile)
+    ensemble_read(&e, ensfile, a, b, c);
+  else {
+    ensemble_alloc(&e, MAX(ens, 1));
+    srandom(ensseed);
+    for(i = 0; i < e.n; i++) {
+      e.x[i] = xx0; e.y[i] = yy0; e.z[i] = zz0;
+      if(i > 0) {
+        e.x[i] += enseps * random_gauss();
+        e.y[i] += enseps * random_gauss();
+        e.z[i] += enseps * random_gauss();
+      }
+      e.a[i] = a; e.b[i] = b; e.c[i] = c;
+    }
+  }
+  for(i = 0; i < e.n; i++)
+    e.tdiv[i] = -1;
+
+  for(i = 0; i < skip + points; i++) {
+    ensemble_step(&e, dt, (i + 1) * dt, diverge * diverge);
+    if(i < skip || (i - skip) % ensevery != 0 || mode == 2) continue;
+    if(mode == 0)
+      ensemble_stats(&e, (i + 1) * dt);
+    else
+      for(j = 0; j < e.n; j++)
+        printf("%g\t%d\t%f\t%f\t%f\n", (i + 1) * dt, j,
+               e.x[j], e.y[j], e.z[j]);
+  }
+  if(mode == 2)
+    for(i = 0; i < e.n; i++)
+      printf("%d\t%g\n", i, e.tdiv[i]);
+}
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
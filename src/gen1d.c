@@ -17,7 +17,9 @@
  *   See the file "maps1d.c" to see how to add user-defined maps.
  * MISCELLANY
  *   Use a plotting program (such as gnuplot) or a spreadsheet
- *   to plot the data.
+ *   to plot the data.  For long series, -format f32 or f64 writes
+ *   binary floats, which are much quicker to produce and to read back
+ *   than text, and -stride keeps only every STRIDE-th point.
  * BUGS
  *   No sanity checks are performed to make sure that any of the
  *   options make sense.
@@ -35,9 +37,9 @@
 #include <string.h>
 #include "misc.h"
 
-int points = 10, skip = 0, box = 0, invert = 0;
+int points = 10, skip = 0, box = 0, invert = 0, stride = 1;
 double r = 1.0, x0 = 0.123456, aux = 1.0;
-char *func = "log";
+char *func = "log", *format = "text";
 
 char help_string[] = "\
 A time series data set is generated by a one-dimensional map \
@@ -49,6 +51,8 @@ added to the file maps1d.c, but you must recompile the program. \
 OPTION options[] = {
   { "-points", OPT_INT,     &points, "Number of points to plot." },
   { "-skip",   OPT_INT,     &skip,   "Number of initial points to skip." },
+  { "-format", OPT_STRING,  &format, "text, csv, f32, f64, or bin." },
+  { "-stride", OPT_INT,     &stride, "Print every STRIDE-th point." },
   { "-r",      OPT_DOUBLE,  &r,      "Value for the r parameter." },
   { "-aux",    OPT_DOUBLE,  &aux,    "Auxiliary map parameter." },
   { "-x0",     OPT_DOUBLE,  &x0,     "Initial value for x." },
@@ -61,23 +65,32 @@ OPTION options[] = {
 
 #include "maps1d.c"
 
+/* The points are made this many at a time. */
+
+#define CHUNK 4096
+
 int main(int argc, char **argv)
 {
-  int i;
-  double x, (*f)(double, double);
+  int i, j, n, map;
+  double x, orbit[CHUNK];
 
   get_options(argc, argv, options, help_string);
+  if(stride < 1) stride = 1;
 
-  f = get_named_function(func);
+  map = get_named_map(func);
 
-  /* Generate the points. */
+  /* Generate the points, with the map inlined into the loop. */
+  data_init(format, "x");
 
-  x = x0;
-  for(i = 0; i < points + skip; i++) {
-    x = f(x, r);
-    if(i >= skip)
-      printf("%f\n", x);
+  x = map1d_iterate(map, x0, r, skip);
+  for(i = 0; i < points; i += n) {
+    n = MIN(CHUNK, points - i);
+    x = map1d_orbit(map, x, r, n, orbit);
+    for(j = 0; j < n; j++)
+      if((i + j) % stride == 0)
+        data_write(&orbit[j]);
   }
+  data_finish();
 
   exit(0);
 }
@@ -2,7 +2,21 @@
 /* NAME
  *   henbif - plot a bifurcation diagram for the Henon system
  * NOTES
- *   None.
+ *   With -fast, the columns are done LANES at a time, in lock step, so
+ *   that the steps of the different columns are independent and can
+ *   overlap.  Columns that have settled into a short cycle or
+ *   diverged are masked off rather than left, and a block stops as
+ *   soon as all of its columns have.  The blocks are divided among
+ *   THREADS threads (or all processors if THREADS is zero).  The
+ *   image is the same as without -fast.
+ *
+ *   The iterations for a column stop early once they repeat, to
+ *   within a small fraction of a pixel, with any period up to MAXPER.
+ *   The cycle is found with Brent's method (see cycle_check() in
+ *   misc.c), which costs one comparison per iteration no matter how
+ *   large MAXPER is.  With -data, nothing is plotted, and each column
+ *   is printed as the value of A (or B) and the period found, zero if
+ *   none was, or -1 if the orbit diverged.
  * BUGS
  *   No sanity checks are performed to make sure that any of the
  *   options make sense.
@@ -20,11 +34,12 @@
 #include "misc.h"
 
 int width = 640, height = 480, skip = 500, box = 0;
-int invert = 0, mag = 1, ab = 1;
+int invert = 0, mag = 1, ab = 1, fast = 0, threads = 1;
+int maxper = 64, data = 0;
 double abmin = 0.0, abmax = 1.4, factor = 2.0, aux = 1.0;
 double ymin = -1.75, ymax = 1.75, A = 1.29, B = 0.3;
 double brmin, brmax, bymin, bymax;
-char *term = NULL;
+char *term = NULL, *format = "text";
 
 char help_string[] = "\
 A bifurcation diagram of the Henon system, which is described by \
@@ -43,6 +58,12 @@ OPTION options[] = {
   { "-A",      OPT_DOUBLE,  &A,      "Value of the A parameter." },
   { "-B",      OPT_DOUBLE,  &B,      "Value of the B parameter." },
   { "-factor", OPT_DOUBLE,  &factor, "Multiplicative factor for iterates." },
+  { "-maxper", OPT_INT,     &maxper, "Longest period to detect." },
+  { "-data",   OPT_SWITCH,  &data,   "Don't plot, but print periods." },
+  { "-format", OPT_STRING,  &format, "text, csv, f32, f64, or bin." },
+  { "-fast",   OPT_SWITCH,  &fast,   "Iterate blocks of columns at once?" },
+  { "-threads", OPT_INT,    &threads,
+    "Number of threads for -fast.  If zero, use all processors." },
   { "-ymin",   OPT_DOUBLE,  &ymin,   "Smallest value for y range." },
   { "-ymax",   OPT_DOUBLE,  &ymax,   "Largest value for y range." },
   { "-box",    OPT_INT,     &box,    "Line width for a box." },
@@ -58,13 +79,99 @@ OPTION options[] = {
 
 /* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
 
+/* The number of columns in a block for -fast, the value of A or B for
+   every column, the period found for every column, and the tolerance
+   for detecting periodic behavior. */
+
+#define LANES 8
+
+static double *rcol, tol;
+static int *period;
+
+/* Iterate the system STEPS times for each of the LANES columns, with
+   parameters A and B, starting from (X, Y).  DIV is set for columns
+   that are outside of the box of size ten before any of the steps or
+   after the last, and is never cleared. */
+
+static void iterate_lanes(double *x, double *y, double *a, double *b,
+                          int *div, int steps)
+{
+  double t;
+  int j, l;
+
+  for(j = 0; j < steps; j++)
+    for(l = 0; l < LANES; l++) {
+      div[l] |= (fabs(x[l]) > 10.0) | (fabs(y[l]) > 10.0);
+      t = a[l] - x[l] * x[l] + b[l] * y[l]; y[l] = x[l]; x[l] = t;
+    }
+  for(l = 0; l < LANES; l++)
+    div[l] |= (fabs(x[l]) > 10.0) | (fabs(y[l]) > 10.0);
+}
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+/* Do the block of columns BLK as the main loop would do them one at a
+   time.  The points are saved up and plotted at the end, since the
+   plot routines can only be used by one thread at a time. */
+
+static void block_task(int blk, void *arg)
+{
+  double x[LANES], y[LANES], a[LANES], b[LANES], r[LANES], *pts;
+  int j, l, n, live, npts = 0, div[LANES], p[LANES];
+  CYCLE cyc[LANES];
+
+  n = MIN(LANES, width - blk * LANES);
+  for(l = 0; l < LANES; l++) {
+    r[l] = rcol[blk * LANES + MIN(l, n - 1)];
+    a[l] = ab ? r[l] : A;
+    b[l] = ab ? B : r[l];
+    x[l] = y[l] = 0.0;
+    cycle_init(&cyc[l], tol, maxper);
+    div[l] = 0;
+  }
+  pts = xmalloc(sizeof(double) * 2 * (LANES * (int) (height * factor) + 1));
+  iterate_lanes(x, y, a, b, div, skip);
+  for(l = 0, live = 0; l < LANES; l++) {
+    p[l] = (l >= n || div[l]) ? -1 : 0;
+    live += (p[l] == 0);
+  }
+
+  for(j = 0; j < height * factor && live > 0; j++) {
+    /* Check if the system diverged. */
+    for(l = 0; l < LANES; l++)
+      if(p[l] == 0 && (fabs(x[l]) > 10.0 || fabs(y[l]) > 10.0)) {
+        p[l] = -1;
+        live--;
+      }
+    iterate_lanes(x, y, a, b, div, 1);
+    for(l = 0; l < LANES; l++) {
+      if(p[l] != 0) continue;
+      pts[npts++] = r[l]; pts[npts++] = x[l];
+      if((p[l] = cycle_check(&cyc[l], x[l])) > 0)
+        live--;
+    }
+  }
+  for(l = 0; l < n; l++)
+    period[blk * LANES + l] = p[l];
+
+  if(!data) {
+    parallel_lock();
+    for(j = 0; j < npts; j += 2)
+      plot_point(pts[j], pts[j + 1], 1);
+    parallel_unlock();
+  }
+  free(pts);
+}
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
 int main(int argc, char **argv)
 {
   extern int plot_mag;
   extern int plot_inverse;
   int i, j;
-  double x, t, y;
-  double xt, xtt, xttt, xtttt, r, rinc, tol;
+  double x, t, y, r, rinc, v[2];
+  CYCLE cyc;
 
   get_options(argc, argv, options, help_string);
 
@@ -72,11 +179,13 @@ int main(int argc, char **argv)
   abmin = (abmin < 0.0) ? 0.0 : (abmin > 2.0) ? 2.0 : abmin;
   abmax = (abmax < 0.0) ? 0.0 : (abmax > 2.0) ? 2.0 : abmax;
   
-  plot_mag = mag;
-  plot_inverse = invert;
-  plot_init(width, height, 2, term);
-  plot_set_range(abmin, abmax, ymin, ymax);
-  plot_set_all(0);
+  if(!data) {
+    plot_mag = mag;
+    plot_inverse = invert;
+    plot_init(width, height, 2, term);
+    plot_set_range(abmin, abmax, ymin, ymax);
+    plot_set_all(0);
+  }
 
   /* One pixel represents this much change in r. */
   rinc = (abmax - abmin) / (width - 1);
@@ -84,46 +193,63 @@ int main(int argc, char **argv)
   /* Tolerance for detecting periodic behavior. */
   tol = 0.01 / height;
 
-  /* For each value of r ... */
-  for(i = 0, r = abmin; i < width; i++, r += rinc) {
-    x = y = 0.0;
+  /* Work out every value of A or B. */
+  rcol = xmalloc(sizeof(double) * width);
+  period = xmalloc(sizeof(int) * width);
+  for(i = 0, r = abmin; i < width; i++, r += rinc)
+    rcol[i] = r;
 
-    /* Start iterating the system to skip some points. */
-    for(j = 0; j < skip; j++) {
-      /* Check if the system diverges. */
-      if(fabs(x) > 10.0 || fabs(y) > 10.0) break;
-      t = (ab ? r : A) - x*x + (ab ? B : r) * y; y = x; x = t;
-    }
-    /* Check if the system diverged. */
-    if(fabs(x) > 10.0 || fabs(y) > 10.0) break;
-
-    /* Set previous iterates to nonsense values so that the test
-     * below initially fail.
-     */
-    xtttt = 5.0; xttt = 4.0; xtt = 3.0; xt = 2.0;
-
-    /* We only need to do this next loop a number of times
-     * proportional to the height of the plot since there are only
-     * a small finite number of points that can be on.
-     */
-    for(j = 0; j < height * factor; j++) {
-      xtttt = xttt; xttt = xtt; xtt = xt; xt = x;
+  /* Either do the columns in blocks, ... */
+  if(fast)
+    parallel_tasks((width + LANES - 1) / LANES, threads, block_task, NULL);
+  else {
+    /* ... or, for each value of r ... */
+    for(i = 0; i < width; i++) {
+      r = rcol[i];
+      x = y = 0.0;
+      period[i] = -1;
 
+      /* Start iterating the system to skip some points. */
+      for(j = 0; j < skip; j++) {
+        /* Check if the system diverges. */
+        if(fabs(x) > 10.0 || fabs(y) > 10.0) break;
+        t = (ab ? r : A) - x*x + (ab ? B : r) * y; y = x; x = t;
+      }
       /* Check if the system diverged. */
-      if(fabs(x) > 10.0 || fabs(y) > 10.0) break;
-
-      /* Calculate a point a plot it. */
-      t = (ab ? r : A) - x*x + (ab ? B : r) * y; y = x; x = t;
-      plot_point(r, x, 1);
+      if(fabs(x) > 10.0 || fabs(y) > 10.0) continue;
 
-      /* Check for period 1, 2, 3, or 4 values, and if found within
-       * a reasonable tolerance, bailout to speed up the computation
-       * of the whole image.
+      /* We only need to do this next loop a number of times
+       * proportional to the height of the plot since there are only
+       * a small finite number of points that can be on.  Stop as soon
+       * as the points repeat, to within a reasonable tolerance, to
+       * speed up the computation of the whole image.
        */
-      if(fabs(x - xt) < tol || fabs(x - xtt) < tol ||
-         fabs(x - xttt) < tol || fabs(x - xtttt) < tol) 
-        break;
-    } 
+      cycle_init(&cyc, tol, maxper);
+      period[i] = 0;
+      for(j = 0; j < height * factor; j++) {
+        /* Check if the system diverged. */
+        if(fabs(x) > 10.0 || fabs(y) > 10.0) {
+          period[i] = -1;
+          break;
+        }
+
+        /* Calculate a point a plot it. */
+        t = (ab ? r : A) - x*x + (ab ? B : r) * y; y = x; x = t;
+        if(!data) plot_point(r, x, 1);
+        if((period[i] = cycle_check(&cyc, x)) > 0)
+          break;
+      } 
+    }
+  }
+
+  if(data) {
+    data_init(format, ab ? "A period" : "B period");
+    for(i = 0; i < width; i++) {
+      v[0] = rcol[i]; v[1] = period[i];
+      data_write(v);
+    }
+    data_finish();
+    exit(0);
   }
 
   /* Plot a box, if appropriate. */
@@ -136,4 +262,3 @@ int main(int argc, char **argv)
 }
 
 /* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
-
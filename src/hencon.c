@@ -2,7 +2,8 @@
 /* NAME
  *   hencon - control the Henon system with the OGY control law
  * NOTES
- *   None.
+ *   With -format, the time series can be written as CSV or binary
+ *   floats instead of labelled text, and -stride thins it out.
  * BUGS
  *   Few sanity checks are performed to make sure that any of the
  *   options make sense.
@@ -21,8 +22,9 @@
 
 
 int points = 300, on1 = 50, off = 100, on2 = 200, skip = 100, seed = 0;
+int stride = 1;
 double A = 1.29, B = 0.3, plimit = 0.2, gauss = 0.0;
-char *term = NULL;
+char *term = NULL, *format = "text";
 
 OPTION options[] = {
   { "-points", OPT_INT,     &points, "The length of the time series." },
@@ -35,6 +37,8 @@ OPTION options[] = {
   { "-A",      OPT_DOUBLE,  &A,      "Value of the A parameter." },
   { "-B",      OPT_DOUBLE,  &B,      "Value of the B parameter." },
   { "-gauss",  OPT_DOUBLE,  &gauss,  "Magnitude of Gaussian noise." },
+  { "-format", OPT_STRING,  &format, "text, csv, f32, f64, or bin." },
+  { "-stride", OPT_INT,     &stride, "Print every STRIDE-th point." },
   { NULL,      OPT_NULL,    NULL,    NULL }
 };
 
@@ -53,9 +57,11 @@ constrained to obey (0 <= on1 <= off <= on2 <= points).\
 int main(int argc, char **argv)
 {
   int i;
-  double x, xf, t, p, y, lu, ls, eu[2], es[2], gu[2], k[2];
+  double x, xf, t, p, y, lu, ls, eu[2], es[2], gu[2], k[2], v[4];
+  int text;
 
   get_options(argc, argv, options, help_string);
+  if(stride < 1) stride = 1;
 
   if(0 > on1 || on1 > off || off > on2 || on2 > points) {
     fprintf(stderr, "Bad choice of on1, on2, off, and/or points.\n");
@@ -87,6 +93,9 @@ int main(int argc, char **argv)
   k[0] = gu[0] * -lu / gu[0];
   k[1] = gu[1] * -lu / gu[0]; 
 
+  text = !strcmp(format, "text");
+  if(!text) data_init(format, "t x y p");
+
   /* Initialize system. */
   srandom(seed);
   x = random_range(-0.1, 0.1);
@@ -112,11 +121,18 @@ int main(int argc, char **argv)
     y = x + gauss * random_gauss();
     x = t;
 
-    /* Output stuff. */
-    if(i >= skip)
-      printf("(t,x[t],y[t],p[t])=\t%d\t% f\t% f\t% f\n",
-             i - skip + 1, x, y, p);
+    /* Output stuff.  Text keeps its old labelled format. */
+    if(i >= skip && (i - skip) % stride == 0) {
+      if(text)
+        printf("(t,x[t],y[t],p[t])=\t%d\t% f\t% f\t% f\n",
+               i - skip + 1, x, y, p);
+      else {
+        v[0] = i - skip + 1; v[1] = x; v[2] = y; v[3] = p;
+        data_write(v);
+      }
+    }
   }
+  data_finish();
 
   exit(0);
 }
@@ -13,6 +13,32 @@
  *   width and height.  If you then change the width or height of the
  *   plot, the relative scales will still match up.  The options for
  *   making a box work similarly.
+ *
+ *   With -data, -format picks between text and binary output, and
+ *   -stride keeps only the points of every STRIDE-th iteration.
+ *
+ *   With -density, the number of points that land in each pixel is
+ *   plotted with LEVELS gray levels, mapped from the counts as given
+ *   by -tone (linear, log, or eq).  The points are divided among
+ *   independent walkers, one per thread given by -threads, that each
+ *   start from their own random initial conditions and count into
+ *   their own array, which are added up at the end.  The results only
+ *   depend on the number of walkers.
+ *
+ *   With -escape, the plot is of the plane of initial conditions
+ *   instead, laid out like the phase space so that the two line up:
+ *   the orbit from each pixel is followed for up to MAXIT steps, and
+ *   the pixel is colored by the step at which the orbit left the box
+ *   of size ten, brighter for later steps, or black if it never did.
+ *   With -basin, the orbits that stay are also followed until they
+ *   repeat, with any period up to MAXPER (see cycle_check() in
+ *   misc.c), and each attractor found gets its own gray level, with
+ *   escaping orbits black and all orbits that never repeat sharing
+ *   one level.  Each row is done LANES pixels at a time, in lock step
+ *   so that the steps of the different pixels can overlap, and the
+ *   rows are divided among THREADS threads (or all processors if
+ *   THREADS is zero).  The plot does not depend on the number of
+ *   threads.
  * BUGS
  *   No sanity checks are performed to make sure that any of the
  *   options make sense.
@@ -31,10 +57,12 @@
 #include "misc.h"
 
 int width = 480, height = 480, skip = 100, points = 1000, invert = 0;
-int box = 0, swap = 1, data = 0, delay = 1, mag = 1;
+int box = 0, swap = 1, data = 0, delay = 1, mag = 1, stride = 1;
 double A = 1.29, B = 0.3;
 double ulx = -1.75, uly = 1.75, lly = -1.75, bulx, buly, blly;
-char *term = NULL;
+int density = 0, levels = 256, threads = 1;
+int escape = 0, basin = 0, maxit = 160, maxper = 64;
+char *term = NULL, *format = "text", *tone = "log";
 
 char help_string[] = "\
 The phase space of the Henon system, which is described by the equation \
@@ -59,6 +87,18 @@ OPTION options[] = {
   { "-buly",   OPT_DOUBLE,  &buly,   "Box's upper-left y-coordinate." },
   { "-blly",   OPT_DOUBLE,  &blly,   "Box's lower-left y-coordinate." },
   { "-data",   OPT_SWITCH,  &data,   "Don't plot, but print points." },
+  { "-format", OPT_STRING,  &format, "text, csv, f32, f64, or bin." },
+  { "-stride", OPT_INT,     &stride, "Print every STRIDE-th point." },
+  { "-density", OPT_SWITCH, &density, "Plot the density of points?" },
+  { "-levels", OPT_INT,     &levels, "Gray levels for -density." },
+  { "-tone",   OPT_STRING,  &tone,   "linear, log, or eq." },
+  { "-escape", OPT_SWITCH,  &escape, "Plot escape times of the plane?" },
+  { "-basin",  OPT_SWITCH,  &basin,  "Plot basins of attraction?" },
+  { "-maxit",  OPT_INT,     &maxit,  "Most steps for -escape and -basin." },
+  { "-maxper", OPT_INT,     &maxper, "Longest period for -basin." },
+  { "-threads", OPT_INT,    &threads,
+    "Number of walkers (or threads for -escape and -basin).  If zero, use \
+all processors." },
   { "-inv",    OPT_SWITCH,  &invert, "Invert all colors?" },
   { "-mag",    OPT_INT,     &mag,    "Magnification factor." },
   { "-term",   OPT_STRING,  &term,   "How to plot points." },
@@ -67,25 +107,257 @@ OPTION options[] = {
 
 /* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
 
+/* The number of walkers for -density, and their arrays of counts. */
+
+static int walkers;
+static unsigned int **hist;
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+/* Walker W iterates the map from its own random initial conditions and
+   counts its share of the points. */
+
+static void walk(int w, void *arg)
+{
+  RANDSTREAM rs;
+  double x, y, t, *hold;
+  int i, h = 0, n = points / walkers + (w < points % walkers);
+
+  random_stream_init(&rs, 0, w);
+  x = random_stream_range(&rs, -0.1, 0.1);
+  y = random_stream_range(&rs, -0.1, 0.1);
+  hold = xmalloc(sizeof(double) * delay);
+  for(i = 0; i < n + skip + delay; i++) {
+    hold[h] = x; h++; h %= delay;
+    t = A - x*x + B * y; y = x; x = t;
+    if(i >= skip + delay) {
+      if(swap) plot_count(hist[w], hold[h], x);
+      else plot_count(hist[w], x, hold[h]);
+    }
+  }
+  free(hold);
+}
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+/* Make a density plot with the walkers run in parallel. */
+
+static void density_plot(void)
+{
+  int i, w, npix = width * height;
+
+  walkers = (threads > 0) ? threads : parallel_threads(0);
+  hist = xmalloc(sizeof(unsigned int *) * walkers);
+  for(w = 0; w < walkers; w++) {
+    hist[w] = xmalloc(sizeof(unsigned int) * npix);
+    memset(hist[w], 0, sizeof(unsigned int) * npix);
+  }
+  parallel_tasks(walkers, threads, walk, NULL);
+  for(w = 1; w < walkers; w++) {
+    for(i = 0; i < npix; i++)
+      hist[0][i] += hist[w][i];
+    free(hist[w]);
+  }
+  plot_counts(hist[0], tone);
+  free(hist[0]);
+  free(hist);
+}
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+/* The number of pixels done at once by -escape and -basin, the right
+   edge of the plot, and, for each pixel, the step at which its orbit
+   escaped (or zero), and, for -basin, the period of the attractor
+   that it reached (or zero) and the smallest x on it. */
+
+#define LANES 8
+
+static double plotlrx;
+static int *esc, *per;
+static double *key;
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+/* Follow an orbit that did not escape from (X, Y) until it repeats, and
+   set its period and key, which is the smallest x on the cycle.
+   Orbits that never repeat have period zero and a key of zero, so
+   they all look like one attractor. */
+
+static void find_attractor(double x, double y, int *period, double *k)
+{
+  CYCLE cyc;
+  double t, x0, y0, tol = 1e-6 * (uly - lly);
+  int i, p;
+
+  cycle_init(&cyc, tol, maxper);
+  *period = 0;
+  *k = 0;
+  for(i = 0, p = 0; i < maxit + 4 * maxper && p == 0; i++) {
+    t = A - x*x + B * y; y = x; x = t;
+    p = cycle_check(&cyc, x);
+  }
+  if(p == 0) return;
+
+  /* Go around the cycle once to find its smallest x, and the first
+   * return in both x and y, since cycle_check() may have found a
+   * multiple of the period in a cycle that has not quite settled.
+   */
+  x0 = x; y0 = y; *k = x;
+  for(i = 1; i <= p; i++) {
+    t = A - x*x + B * y; y = x; x = t;
+    *k = MIN(*k, x);
+    if(*period == 0 && fabs(x - x0) <= tol && fabs(y - y0) <= tol)
+      *period = i;
+  }
+  if(*period == 0) *period = p;
+}
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+/* Do row J of the plane.  The pixels of a row are done LANES at a
+   time, and stop when all of them have escaped. */
+
+static void escape_row(int j, void *arg)
+{
+  double x[LANES], y[LANES], h, v, t;
+  int i, k, l, n, e[LANES], all;
+
+  v = uly - (uly - lly) * j / MAX(height - 1, 1);
+  for(i = 0; i < width; i += LANES) {
+    n = MIN(LANES, width - i);
+    for(l = 0; l < LANES; l++) {
+      h = ulx + (plotlrx - ulx) * (i + MIN(l, n - 1)) / MAX(width - 1, 1);
+      x[l] = swap ? v : h;
+      y[l] = swap ? h : v;
+      e[l] = 0;
+    }
+    for(k = 1, all = 0; k <= maxit && !all; k++) {
+      for(l = 0; l < LANES; l++) {
+        t = A - x[l] * x[l] + B * y[l]; y[l] = x[l]; x[l] = t;
+        e[l] = (e[l] == 0 && !(fabs(x[l]) <= 10.0 && fabs(y[l]) <= 10.0)) ?
+          k : e[l];
+      }
+      if(k % 16 == 0)
+        for(l = 0, all = 1; l < LANES; l++)
+          all &= (e[l] != 0);
+    }
+    for(l = 0; l < n; l++) {
+      esc[j * width + i + l] = e[l];
+      if(basin && e[l] == 0)
+        find_attractor(x[l], y[l], &per[j * width + i + l],
+                       &key[j * width + i + l]);
+    }
+  }
+}
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+/* Order pixels by the period and then the key of their attractors. */
+
+static int compare_attractors(const void *a, const void *b)
+{
+  int i = *(const int *) a, j = *(const int *) b;
+
+  if(per[i] != per[j]) return(per[i] - per[j]);
+  return((key[i] > key[j]) - (key[i] < key[j]));
+}
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+/* Plot the escape times, or the basins of attraction, of the plane
+   whose right edge is at LRX. */
+
+static void escape_plot(double lrx)
+{
+  int i, npix = width * height, nidx, label, slow, *idx, *val;
+  double tol = 0.001 * (uly - lly);
+
+  plotlrx = lrx;
+  esc = xmalloc(sizeof(int) * npix);
+  per = xmalloc(sizeof(int) * npix);
+  key = xmalloc(sizeof(double) * npix);
+  val = xmalloc(sizeof(int) * npix);
+  parallel_tasks(height, threads, escape_row, NULL);
+
+  /* Escape times are spread over the gray levels, from one for the
+   * fastest to the last for the slowest.
+   */
+  if(!basin) {
+    for(i = 0, slow = 1; i < npix; i++)
+      slow = MAX(slow, esc[i]);
+    for(i = 0; i < npix; i++)
+      if(esc[i] == 0) val[i] = 0;
+      else val[i] = 1 + (esc[i] - 1) * (levels - 2) / MAX(slow - 1, 1);
+  }
+  else {
+    /* Sort the pixels that stayed by their attractors, so that the
+     * attractors can be numbered in an order that does not depend on
+     * the threads, and then spread the numbers over the gray levels.
+     */
+    idx = xmalloc(sizeof(int) * npix);
+    for(i = 0, nidx = 0; i < npix; i++) {
+      val[i] = 0;
+      if(esc[i] == 0) idx[nidx++] = i;
+    }
+    qsort(idx, nidx, sizeof(int), compare_attractors);
+    for(i = 0, label = 0; i < nidx; i++) {
+      if(i == 0 || per[idx[i]] != per[idx[i - 1]] ||
+         key[idx[i]] - key[idx[i - 1]] > tol) label++;
+      val[idx[i]] = label;
+    }
+    for(i = 0; i < nidx; i++)
+      val[idx[i]] = val[idx[i]] * (levels - 1) / label;
+    free(idx);
+  }
+
+  /* Plot in pixel coordinates, and then put the range back for the
+   * box.
+   */
+  plot_set_range(0, width - 1, height - 1, 0);
+  for(i = 0; i < npix; i++)
+    plot_point(i % width, i / width, val[i]);
+  plot_set_range(ulx, lrx, lly, uly);
+  free(esc); free(per); free(key); free(val);
+}
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
 int main(int argc, char **argv)
 {
   extern int plot_mag;
   extern int plot_inverse;
   int i, h;
-  double x, t, y, a, b, lrx, blrx;
+  double x, t, y, a, b, lrx, blrx, v[2];
   double *hold;
 
   get_options(argc, argv, options, help_string);
+  if(stride < 1) stride = 1;
   
   /* Calculate the area covered by a single pixel. */
   lrx = ulx + ((uly - lly) / (height - 1)) * (width - 1);
 
-  if(!data) {
+  if(data)
+    data_init(format, "x y");
+  else {
     plot_mag = mag;
     plot_inverse = invert;
-    plot_init(width, height, 2, term);
+    plot_init(width, height, (density || escape || basin) ? levels : 2,
+              term);
     plot_set_range(ulx, lrx, lly, uly);
-    plot_set_all(0);
+    if(escape || basin) {
+      /* The plane is plotted instead of an orbit. */
+      escape_plot(lrx);
+      points = skip = 0;
+    }
+    else if(density) {
+      /* The walkers do all of the plotting, so the loop below has no
+       * points left to plot.
+       */
+      density_plot();
+      points = skip = 0;
+    }
+    else
+      plot_set_all(0);
   }
 
   /* Use random initial conditions. */
@@ -110,8 +382,11 @@ int main(int argc, char **argv)
     if(i >= skip + delay) {
       /* Only show points that are within the asked for region. */
       if(a > ulx && a < lrx && b > lly && b < uly) {
-        if(data) printf("%f\t%f\n", a, b);
-        else plot_point(a, b, 1);
+        if(!data) plot_point(a, b, 1);
+        else if((i - skip - delay) % stride == 0) {
+          v[0] = a; v[1] = b;
+          data_write(v);
+        }
       }
     }
   }
@@ -123,7 +398,8 @@ int main(int argc, char **argv)
     plot_box(bulx, buly, blrx, blly, box);
   }
 
-  if(!data) plot_finish();
+  if(data) data_finish();
+  else plot_finish();
   exit(0);
 }
 
@@ -6,6 +6,42 @@
  *   auto-scaling builtin to it.  Thus, the implementation could be
  *   made a bit simpler by exploiting it, but I decided not to
  *   bother fixing what already worked.
+ *
+ *   Rules are picked with Walker's alias method: after the rules are
+ *   loaded, the probabilities are rearranged into a table of RULES
+ *   columns, each holding at most two rules, so that a rule is picked
+ *   in constant time with a single random number no matter how many
+ *   rules there are.  Points are converted to pixels and passed to
+ *   the plot routines in batches.
+ *
+ *   If -threads is not one or -levels is more than two (without
+ *   -super), the image is a density plot instead.  The iterations
+ *   are divided among THREADS independent walkers, each with its own
+ *   random number stream and its own transient of SKIP steps, that
+ *   run in parallel and count the hits on each pixel in private
+ *   histograms.  The histograms are
+ *   summed at the end and the counts are mapped onto LEVELS gray
+ *   levels, linearly or, with -log, by the logarithm of the count.
+ *   Every pixel that is hit at least once gets a nonzero gray level.
+ *   The results only depend on the number of walkers, and not on how
+ *   many threads are actually available.
+ *
+ *   With -det, the chaos game is replaced by the deterministic
+ *   algorithm.  The image starts out completely filled, and each
+ *   step replaces it with the union of its copies under every rule,
+ *   computed directly on a bitmap with one bit per pixel.  The steps
+ *   stop as soon as an image is the same as the one before it, or
+ *   after DEPTH steps, so the cost depends on the size of the plot
+ *   and not on a number of points, and the result has no noise.
+ *
+ *   With -super K, every point is plotted on a grid that is K times
+ *   finer than the plot, and each K by K block of the grid becomes
+ *   one pixel with one of LEVELS gray levels that says how much of
+ *   the block is covered.  This smooths the edges of the fractal much
+ *   as a density plot does, but it works with the chaos game and with
+ *   -det, and costs no more iterations.  -super cannot be combined
+ *   with a density plot, so -threads must be one, and -levels only
+ *   sets the number of levels of coverage.
  * MISCELLANY
  *   There is a shell script called 'ifscma' supplied with the source
  *   code that has a simple interface that allows you to reference
@@ -36,8 +72,11 @@
 
 double a[MAXRULES], b[MAXRULES], c[MAXRULES];
 double d[MAXRULES], e[MAXRULES], f[MAXRULES], p[MAXRULES];
+double prob[MAXRULES];
+int alias[MAXRULES];
 int border = 10, width = 640, height = 480, skip = 50, its = 1000;
 int xoff, yoff, rules, boxwidth, invert = 0, mag = 1;
+int threads = 1, levels = 2, logmap = 0, det = 0, depth = 50, super = 1;
 char *term = NULL, *infile = "-";
 
 char help_string[] =  "\
@@ -57,6 +96,13 @@ OPTION options[] = {
   { "-its",    OPT_INT,     &its,    "Number of iterations."             },
   { "-skip",   OPT_INT,     &skip,   "Number of iteration to skip."      },
   { "-term",   OPT_STRING,  &term,   "How to plot points."               },
+  { "-threads", OPT_INT,    &threads,
+    "Number of walkers (and threads).  If zero, use all processors." },
+  { "-levels", OPT_INT,     &levels, "Number of plot (gray) levels."    },
+  { "-log",    OPT_SWITCH,  &logmap, "Map densities logarithmically?"  },
+  { "-det",    OPT_SWITCH,  &det,    "Use the deterministic algorithm?" },
+  { "-depth",  OPT_INT,     &depth,  "Maximum steps for -det."          },
+  { "-super",  OPT_INT,     &super,  "Supersampling factor."            },
   { "-inv",    OPT_SWITCH,  &invert, "Invert colors?" },
   { "-mag",    OPT_INT,     &mag,    "Magnification factor." },
   { NULL,      OPT_NULL,    NULL,    NULL                                }
@@ -64,6 +110,53 @@ OPTION options[] = {
 
 /* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
 
+/* Build the alias table for the probabilities in p[].  Column i of
+   the table picks rule i with probability prob[i] and rule alias[i]
+   otherwise.  Columns are filled by pairing a rule with less than
+   the average probability with one that has more, which leaves the
+   larger one with less left over.  This is Vose's version of
+   Walker's method. */
+
+static void build_alias(void)
+{
+  int small[MAXRULES], large[MAXRULES], ns, nl, i, sm, lg;
+  double q[MAXRULES];
+
+  ns = nl = 0;
+  for(i = 0; i < rules; i++) {
+    q[i] = p[i] * rules;
+    if(q[i] < 1.0)
+      small[ns++] = i;
+    else
+      large[nl++] = i;
+  }
+  while(ns > 0 && nl > 0) {
+    sm = small[--ns];
+    lg = large[--nl];
+    prob[sm] = q[sm];
+    alias[sm] = lg;
+    q[lg] = (q[lg] + q[sm]) - 1.0;
+    if(q[lg] < 1.0)
+      small[ns++] = lg;
+    else
+      large[nl++] = lg;
+  }
+
+  /* Whatever is left over is only off by round-off. */
+  while(nl > 0) {
+    lg = large[--nl];
+    prob[lg] = 1.0;
+    alias[lg] = lg;
+  }
+  while(ns > 0) {
+    sm = small[--ns];
+    prob[sm] = 1.0;
+    alias[sm] = sm;
+  }
+}
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
 /* Load the affines linear rules from the named file.  If fname is
    equal to "-", then read from stdin. */
 
@@ -134,6 +227,205 @@ void load_rules(char *fname)
   }
   for(i = 0; i < rules; i++)
     p[i] /= sum;
+
+  build_alias();
+}
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+/* Number of points to buffer before plotting. */
+
+#define BATCH 4096
+
+/* Pick a rule from the alias table.  The integer part of the scaled
+   random number selects a column and the fraction selects one of the
+   column's two rules. */
+
+static int pick_rule(double u)
+{
+  double r;
+  int j;
+
+  r = u * rules;
+  j = r;
+  return((r - j < prob[j]) ? j : alias[j]);
+}
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+/* One histogram per walker for the density plot. */
+
+static unsigned int **hist;
+static int walkers;
+
+/* Run walker w with its own random stream, counting hits in its own
+   histogram. */
+
+static void walk(int w, void *arg)
+{
+  RANDSTREAM rs;
+  unsigned int *h;
+  double x, y, t;
+  int i, j, n, ax, ay;
+
+  random_stream_init(&rs, 0, w);
+  h = hist[w];
+  memset(h, 0, sizeof(unsigned int) * width * height);
+  n = its / walkers + (w < its % walkers);
+  x = random_stream_range(&rs, 0.0, 1.0);
+  y = random_stream_range(&rs, 0.0, 1.0);
+  for(i = 0; i < skip + n; i++) {
+    j = pick_rule(random_stream_range(&rs, 0.0, 1.0));
+    t = a[j] * x + b[j] * y + e[j];
+    y = c[j] * x + d[j] * y + f[j];
+    x = t;
+    if(i >= skip) {
+      ax = x * (boxwidth - 1) + xoff + 0.5;
+      ay = height - (int)(y * (boxwidth - 1) + yoff + 0.5);
+      if(ax >= 0 && ax < width && ay >= 0 && ay < height)
+        h[ay * width + ax]++;
+    }
+  }
+}
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+/* Make a density plot with the walkers run in parallel. */
+
+static void plot_density(void)
+{
+  unsigned int *h, hmax;
+  double scale;
+  int i, w, val;
+
+  walkers = (threads > 0) ? threads : parallel_threads(0);
+  hist = xmalloc(sizeof(unsigned int *) * walkers);
+  for(w = 0; w < walkers; w++)
+    hist[w] = xmalloc(sizeof(unsigned int) * width * height);
+
+  parallel_tasks(walkers, threads, walk, NULL);
+
+  /* Merge the histograms into the first one. */
+  h = hist[0];
+  for(w = 1; w < walkers; w++) {
+    for(i = 0; i < width * height; i++)
+      h[i] += hist[w][i];
+    free(hist[w]);
+  }
+  for(i = 0, hmax = 0; i < width * height; i++)
+    hmax = MAX(hmax, h[i]);
+
+  /* Map the counts to gray levels. */
+  if(logmap)
+    scale = (levels - 1) / log(1.0 + hmax);
+  else
+    scale = (double) (levels - 1) / hmax;
+  for(i = 0; i < width * height; i++)
+    if(h[i] > 0) {
+      val = scale * (logmap ? log(1.0 + h[i]) : h[i]);
+      plot_point(i % width, i / width, MAX(val, 1));
+    }
+  free(h);
+  free(hist);
+}
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+/* Bits per word of a bitmap. */
+
+#define WBITS (8 * (int) sizeof(unsigned long))
+
+/* Make one step of the deterministic algorithm: dst becomes the union
+   of the copies of src under every rule.  Each row of a bitmap takes
+   up rw words, and the rules (pa through pf) have been rewritten to
+   map pixel coordinates to pixel coordinates.  Returns 1 if dst is
+   the same as src. */
+
+static int det_step(unsigned long *src, unsigned long *dst, int rw,
+                    double *pa, double *pb, double *pc, double *pd,
+                    double *pe, double *pf)
+{
+  unsigned long word;
+  double u, v;
+  int i, j, k, r, ax, ay;
+
+  memset(dst, 0, sizeof(unsigned long) * rw * height);
+  for(j = 0; j < height; j++)
+    for(k = 0; k < rw; k++) {
+      /* Whole words of empty pixels are skipped. */
+      if((word = src[j * rw + k]) == 0)
+        continue;
+      for(i = k * WBITS; word; i++, word >>= 1) {
+        if(!(word & 1))
+          continue;
+        for(r = 0; r < rules; r++) {
+          u = pa[r] * i + pb[r] * j + pe[r];
+          v = pc[r] * i + pd[r] * j + pf[r];
+          ax = floor(u + 0.5);
+          ay = floor(v + 0.5);
+          if(ax >= 0 && ax < width && ay >= 0 && ay < height)
+            dst[ay * rw + ax / WBITS] |= 1UL << (ax % WBITS);
+        }
+      }
+    }
+  return(memcmp(src, dst, sizeof(unsigned long) * rw * height) == 0);
+}
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+/* Plot the attractor with the deterministic algorithm. */
+
+static void plot_det(void)
+{
+  double pa[MAXRULES], pb[MAXRULES], pc[MAXRULES];
+  double pd[MAXRULES], pe[MAXRULES], pf[MAXRULES], s, h;
+  unsigned long *src, *dst, *t, word;
+  int i, j, k, n, rw, bx[BATCH], by[BATCH];
+
+  /* Rewrite each rule so that it maps pixels to pixels, with the same
+   * scaling and the flipped y axis that the chaos game uses.
+   */
+  s = boxwidth - 1;
+  h = height - yoff;
+  for(i = 0; i < rules; i++) {
+    pa[i] = a[i];
+    pb[i] = -b[i];
+    pe[i] = xoff - a[i] * xoff + b[i] * h + e[i] * s;
+    pc[i] = -c[i];
+    pd[i] = d[i];
+    pf[i] = h + c[i] * xoff - d[i] * h - f[i] * s;
+  }
+
+  rw = (width + WBITS - 1) / WBITS;
+  src = xmalloc(sizeof(unsigned long) * rw * height);
+  dst = xmalloc(sizeof(unsigned long) * rw * height);
+
+  /* Start with every pixel set. */
+  memset(src, 0, sizeof(unsigned long) * rw * height);
+  for(j = 0; j < height; j++)
+    for(i = 0; i < width; i++)
+      src[j * rw + i / WBITS] |= 1UL << (i % WBITS);
+
+  for(k = 0; k < depth; k++) {
+    n = det_step(src, dst, rw, pa, pb, pc, pd, pe, pf);
+    t = src; src = dst; dst = t;
+    if(n) break;
+  }
+
+  for(j = 0, n = 0; j < height; j++)
+    for(k = 0; k < rw; k++)
+      for(i = k * WBITS, word = src[j * rw + k]; word; i++, word >>= 1)
+        if(word & 1) {
+          bx[n] = i;
+          by[n] = j;
+          if(++n == BATCH) {
+            plot_pixels(n, bx, by, 1);
+            n = 0;
+          }
+        }
+  plot_pixels(n, bx, by, 1);
+  free(src);
+  free(dst);
 }
 
 /* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
@@ -142,51 +434,72 @@ int main(int argc, char **argv)
 { 
   extern int plot_mag;
   extern int plot_inverse;
-  double x, y, t, r, s;
-  int i, j, ax, ay;
+  extern int plot_super;
+  double x, y, t;
+  int i, j, n, bx[BATCH], by[BATCH];
 
   get_options(argc, argv, options, help_string);
 
+  if(super > 1 && threads != 1) {
+    fprintf(stderr, "A density plot (-threads) cannot be supersampled.\n");
+    exit(1);
+  }
+
   load_rules(infile);
 
   plot_mag = mag;
   plot_inverse = invert;
-  plot_init(width, height, 2, term);
+  plot_super = super;
+  width *= super;
+  height *= super;
+  border *= super;
+  plot_init(width, height, levels, term);
   plot_set_all(0);
 
   boxwidth = MIN(width, height) - 2 * border;
   xoff = (width - boxwidth) / 2;
   yoff = (height - boxwidth) / 2;
 
+  if(det) {
+    plot_det();
+    plot_finish();
+    exit(0);
+  }
+  if(threads != 1 || (levels > 2 && super == 1)) {
+    plot_density();
+    plot_finish();
+    exit(0);
+  }
+
   x = random_range(0.0, 1.0);
   y = random_range(0.0, 1.0);
-  i = 0;
-
-  /* Loop for the total iterations plus the skip count ... */
-  while(i < (its + skip)) {
-    
-    /* Pick a rule with a roulette-like choice. */
-    j = 0;
-    s = p[j];
-    r = random_range(0.0, 1.0);
-    while(s < r) {
-      j++;
-      s += p[j];
-    }
+
+  /* Skip the first few points so that the orbit is on the fractal. */
+  for(i = 0; i < skip; i++) {
+    j = pick_rule(random_range(0.0, 1.0));
+    t = a[j] * x + b[j] * y + e[j];
+    y = c[j] * x + d[j] * y + f[j];
+    x = t;
+  }
+
+  /* Loop for the total iterations ... */
+  for(i = 0, n = 0; i < its; i++) {
+    j = pick_rule(random_range(0.0, 1.0));
 
     /* Tranform the point via the affine transformation. */
     t = a[j] * x + b[j] * y + e[j];
     y = c[j] * x + d[j] * y + f[j];
     x = t;
 
-    /* Plot the point if we've skipped enough. */
-    if(i >= skip) {
-      ax = x * (boxwidth - 1) + xoff + 0.5;
-      ay = height - (int)(y * (boxwidth - 1) + yoff + 0.5);
-      plot_point(ax, ay, 1);
+    /* Save the pixel, and plot the batch when it is full. */
+    bx[n] = x * (boxwidth - 1) + xoff + 0.5;
+    by[n] = height - (int)(y * (boxwidth - 1) + yoff + 0.5);
+    if(++n == BATCH) {
+      plot_pixels(n, bx, by, 1);
+      n = 0;
     }
-    i++;
   }
+  plot_pixels(n, bx, by, 1);
 
   plot_finish();
   exit(0);
@@ -5,6 +5,49 @@
  *   The autoscaling features of the plot library are not used because
  *   there is a slim chance of round-off problems resulting in a
  *   skipped line.
+ *
+ *   With -prog, the image is first computed on a coarse grid with
+ *   PSTEP pixels between samples, with each sample filling its
+ *   block, and the grid is then halved until every pixel is
+ *   computed.  Samples from coarser passes are reused, so the total
+ *   work is the same as a normal render.  The plot is updated after
+ *   each pass; with the pgm terminal each pass is written as a
+ *   separate image, so stdout becomes a stream of pgm files.
+ *
+ *   The -precision option selects the arithmetic of the iteration:
+ *   float is fastest, double is the default, and dd (double-double)
+ *   is about twice as precise as double but several times slower.
+ *   With auto, the cheapest type whose round-off is safely below
+ *   the pixel spacing is used, which is float for wide views and dd
+ *   for deep zooms.
+ *
+ *   With -miim, the escape-time method is replaced with the modified
+ *   inverse iteration method, which plots only the boundary of the
+ *   Julia set.  Starting from the repelling fixed point of z^2 + c,
+ *   which is in the Julia set, the two preimages +/- sqrt(z - c) of
+ *   every point are visited recursively up to a depth of MAXIT.  The
+ *   preimages are dense in the Julia set, but the tree of preimages
+ *   grows exponentially, so a branch is pruned as soon as it lands on
+ *   a pixel that has already been visited VISITS times.  Each visited
+ *   pixel is plotted with the highest gray level.  Points outside of
+ *   the view are counted the same way, in cells the size of a pixel
+ *   that are kept in a hash table, so that branches that leave the
+ *   view and come back into it are pruned no sooner in a zoomed view
+ *   than in the whole one.  The price is that the time and memory
+ *   grow with the magnification, since the whole boundary is walked
+ *   at the resolution of the view.
+ *
+ *   With positive -acols and -arows, an atlas of Julia sets is drawn
+ *   instead of a single one.  The plot is divided into ACOLS x AROWS
+ *   tiles, and each tile shows the view given by -ulx, -uly, and -lly
+ *   of the Julia set for one value of c.  The values of c are taken
+ *   from a grid in the c plane that is placed the same way as a view,
+ *   with the c of the upper-left tile at (CULX, CULY) and the c of
+ *   the lower-left tile at imaginary part CLLY.  If the orbit of zero
+ *   diverges for some c, then c is not in the Mandelbrot set, its
+ *   Julia set is a disconnected dust, and its tile is left blank
+ *   without computing it.  The tiles are computed in parallel and
+ *   emitted as one image.
  * COLORS
  *   The four permutations of using or not using -rev and -inv will
  *   yield four different coloring schemes.  Try it and see.
@@ -40,7 +83,10 @@ int width = 640, height = 480, maxit = 160, mag = 1;
 int levels = 256, idiv = 1, box = 0, rev = 0, invert = 0;
 double cr = 0.3, ci = 0.6, ulx = -2.0, uly = 1.5, lly = -1.5;
 double bulx, buly, blly, bail = 16.0;
-char *term = NULL;
+int prog = 0, pstep = 16, miim = 0, visits = 2;
+int acols = 0, arows = 0, threads = 0;
+double culx = -2.0, culy = 1.2, clly = -1.2;
+char *term = NULL, *precision = "double";
 
 char help_string[] = "\
 A Julia set is drawn according to the specified parameters.  The  \
@@ -79,59 +125,403 @@ OPTION options[] = {
   { "-rev",    OPT_SWITCH,  &rev,    "Reverse all colors but first?" },
   { "-inv",    OPT_SWITCH,  &invert, "Invert all colors?" },
   { "-mag",    OPT_INT,     &mag,    "Magnification factor." },
+  { "-prog",   OPT_SWITCH,  &prog,   "Render progressively?" },
+  { "-pstep",  OPT_INT,     &pstep,
+    "Initial pixel step of a progressive render." },
+  { "-miim",   OPT_SWITCH,  &miim,
+    "Plot only the boundary with inverse iteration?" },
+  { "-visits", OPT_INT,     &visits,
+    "Maximum number of visits to a pixel with -miim." },
+  { "-acols",  OPT_INT,     &acols,
+    "Number of columns in an atlas of Julia sets." },
+  { "-arows",  OPT_INT,     &arows,
+    "Number of rows in an atlas of Julia sets." },
+  { "-culx",   OPT_DOUBLE,  &culx,
+    "Upper-left corner x-coordinate of the atlas in the c plane." },
+  { "-culy",   OPT_DOUBLE,  &culy,
+    "Upper-left corner y-coordinate of the atlas in the c plane." },
+  { "-clly",   OPT_DOUBLE,  &clly,
+    "Lower-left corner y-coordinate of the atlas in the c plane." },
+  { "-threads", OPT_INT,    &threads,
+    "Number of threads for an atlas.  If zero, use all processors." },
+  { "-precision", OPT_STRING, &precision,
+    "Arithmetic to use: one of float, double, dd, or auto." },
   { "-term",   OPT_STRING,  &term,   "how to plot points"             },
   { NULL,      OPT_NULL,    NULL,    NULL                             }
 };
 
 /* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
 
+/* The escape-time kernels, where z(0) is the pixel and c = (pa, pb).
+   The step is the complex equation, which sets the updates to
+   z = (za, zb). */
+
+#include "precision.c"
+
+#define ESCAPE_INIT(P, l) \
+  ca[l] = P ## _set(pa); \
+  cb[l] = P ## _set(pb)
+
+#define ESCAPE_STEP(P, l) \
+  u[l] = P ## _sqr(za[l]); \
+  v[l] = P ## _sqr(zb[l]); \
+  zb[l] = P ## _add(P ## _twice(P ## _mul(za[l], zb[l])), cb[l]); \
+  za[l] = P ## _add(P ## _sub(u[l], v[l]), ca[l])
+
+ESCAPE_KERNEL(escape_flt, float, flt, 16)
+ESCAPE_KERNEL(escape_dbl, double, dbl, 8)
+ESCAPE_KERNEL(escape_dd, DD, dd, 1)
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+/* Returns the kernel for the requested precision, given a view with
+   upper-left corner (ox, oy), pixel size inc, and size w x h. */
+
+static ESCAPEFUNC escape_kernel(double ox, double oy, double inc,
+                                int w, int h)
+{
+  double scale;
+
+  scale = MAX(MAX(fabs(ox), fabs(ox + (w - 1) * inc)),
+              MAX(fabs(oy), fabs(oy - (h - 1) * inc)));
+  scale = MAX(scale, sqrt(bail));
+  switch(get_precision(precision, inc, scale)) {
+    case PREC_FLOAT:
+      return(escape_flt);
+    case PREC_DD:
+      return(escape_dd);
+    default:
+      return(escape_dbl);
+  }
+}
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+/* Maps an escape time to a gray level. */
+
+static int color(int k)
+{
+  if(k == 0)
+    return(0);
+  if(rev)
+    return(-((k / idiv + (k % idiv) * (levels / idiv)) % levels) +
+           levels - 1);
+  else
+    return((k / idiv + (k % idiv) * (levels / idiv)) % levels);
+}
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+/* Fill the STEP x STEP block with the upper-left corner at (i, j),
+   clipped to the plot. */
+
+static void fill_block(int i, int j, int step, int val)
+{
+  int jj, last;
+
+  last = MIN(i + step, width) - 1;
+  for(jj = j; jj < j + step && jj < height; jj++)
+    if(last == i)
+      plot_point(i, jj, val);
+    else
+      plot_line(i, jj, last, jj, val);
+}
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+/* Render in passes of decreasing step size.  A pixel that lies on
+   the grid of the previous pass was computed there and its block
+   already has the right color in the upper-left quadrant, so only
+   the three new samples per old block are computed. */
+
+static void render_progressive(ESCAPEFUNC escape, double inc)
+{
+  int i, j, n, step, top, first, stride, *row;
+
+  row = xmalloc(sizeof(int) * width);
+  for(top = 1; top * 2 <= pstep; top *= 2) ;
+  for(step = top; step >= 1; step /= 2) {
+    for(j = 0; j < height; j += step) {
+      if(step < top && j % (2 * step) == 0)
+        first = step, stride = 2 * step;
+      else
+        first = 0, stride = step;
+      if((n = (width - first + stride - 1) / stride) <= 0)
+        continue;
+      escape(ulx, uly, inc, cr, ci, first, stride, j, n, row);
+      for(i = 0; i < n; i++)
+        fill_block(first + i * stride, j, step, color(row[i]));
+    }
+    if(step > 1)
+      plot_frame();
+  }
+  free(row);
+}
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+/* Open addressing hash table of the cells outside of the view that
+   -miim has visited, which are the size of a pixel and numbered like
+   the pixels, with each entry holding the column, the row, and the
+   number of visits.  The table is doubled when it gets half full. */
+
+static int *off_table = NULL, off_size = 0, off_used = 0;
+
+#define OFF_EMPTY (-0x7fffffff)
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+static unsigned long off_hash(int i, int j)
+{
+  unsigned long h;
+
+  h = (2166136261UL ^ (unsigned long) (unsigned) i) * 16777619UL;
+  h = (h ^ (unsigned long) (unsigned) j) * 16777619UL;
+  return(h ^ (h >> 15));
+}
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+/* Return the number of visits to the cell in column I and row J, which
+   is added to the table with no visits if it is not there yet.  The
+   pointer is good until the next call. */
+
+static int *off_count(int i, int j)
+{
+  int *old, oldsize, k, n;
+  unsigned long h;
+
+  if(2 * (off_used + 1) > off_size) {
+    old = off_table;
+    oldsize = off_size;
+    off_size = (off_size == 0) ? 4096 : 2 * off_size;
+    off_table = xmalloc(sizeof(int) * 3 * off_size);
+    for(k = 0; k < off_size; k++)
+      off_table[3 * k] = OFF_EMPTY;
+    off_used = 0;
+    for(k = 0; k < oldsize; k++)
+      if(old[3 * k] != OFF_EMPTY)
+        *off_count(old[3 * k], old[3 * k + 1]) = old[3 * k + 2];
+    if(old) free(old);
+  }
+  h = off_hash(i, j);
+  for(k = h & (off_size - 1); off_table[3 * k] != OFF_EMPTY;
+      k = (k + 1) & (off_size - 1))
+    if(off_table[3 * k] == i && off_table[3 * k + 1] == j)
+      return(&off_table[3 * k + 2]);
+  n = 3 * k;
+  off_table[n] = i;
+  off_table[n + 1] = j;
+  off_table[n + 2] = 0;
+  off_used++;
+  return(&off_table[n + 2]);
+}
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+/* Plot the boundary of the Julia set with the modified inverse
+   iteration method.  The preimage tree is walked depth first with an
+   explicit stack, which never holds more than two entries per level. */
+
+static void render_miim(double inc)
+{
+  double *sa, *sb, a, b, r, wa, wb, u, v;
+  int *count, *cnt, *sd, top, d, i, j;
+
+  count = xmalloc(sizeof(int) * width * height);
+  memset(count, 0, sizeof(int) * width * height);
+  sa = xmalloc(sizeof(double) * (2 * maxit + 2));
+  sb = xmalloc(sizeof(double) * (2 * maxit + 2));
+  sd = xmalloc(sizeof(int) * (2 * maxit + 2));
+
+  /* The repelling fixed point is (1 + sqrt(1 - 4c)) / 2, where the
+     branch of the root is chosen to make |2z| as large as possible. */
+  wa = 1.0 - 4.0 * cr;
+  wb = -4.0 * ci;
+  r = sqrt(wa * wa + wb * wb);
+  a = sqrt(0.5 * (r + wa));
+  b = (wb < 0 ? -1 : 1) * sqrt(0.5 * (r - wa));
+  sa[0] = 0.5 * (1.0 + a);
+  sb[0] = 0.5 * b;
+  sd[0] = 0;
+  top = 1;
+
+  while(top > 0) {
+    top--;
+    a = sa[top];
+    b = sb[top];
+    d = sd[top];
+
+    /* Find the counter for this point, either a pixel in the view or
+       a cell outside of it.  Cells too far away to be numbered with
+       an int are merged at the edge. */
+    u = floor((a - ulx) / inc + 0.5);
+    v = floor((uly - b) / inc + 0.5);
+    if(u >= 0 && u < width && v >= 0 && v < height) {
+      i = u; j = v;
+      cnt = &count[j * width + i];
+    }
+    else {
+      i = MAX(-0x3fffffff, MIN(0x3fffffff, u));
+      j = MAX(-0x3fffffff, MIN(0x3fffffff, v));
+      cnt = off_count(i, j);
+      i = -1;
+    }
+    if(*cnt >= visits)
+      continue;
+    if(*cnt == 0 && i >= 0)
+      plot_point(i, j, levels - 1);
+    (*cnt)++;
+
+    /* Push both preimages, +/- sqrt(z - c). */
+    if(d < maxit) {
+      wa = a - cr;
+      wb = b - ci;
+      r = sqrt(wa * wa + wb * wb);
+      a = sqrt(0.5 * (r + wa));
+      b = (wb < 0 ? -1 : 1) * sqrt(0.5 * (r - wa));
+      sa[top] = a;
+      sb[top] = b;
+      sd[top++] = d + 1;
+      sa[top] = -a;
+      sb[top] = -b;
+      sd[top++] = d + 1;
+    }
+  }
+  free(count);
+  free(off_table);
+  off_table = NULL;
+  off_size = off_used = 0;
+  free(sa);
+  free(sb);
+  free(sd);
+}
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+/* The atlas image, in row major order, and what the tiles share. */
+
+static int *atlas, atlas_tw, atlas_th;
+static double atlas_inc, atlas_cinc;
+static ESCAPEFUNC atlas_escape;
+
+/* Returns true if the orbit of zero under z^2 + (a + bi) stays
+   bounded, i.e., if the Julia set for that c is connected. */
+
+static int connected(double a, double b)
+{
+  double x, y, u, v;
+  int k;
+
+  x = y = 0.0;
+  for(k = 1; k <= maxit; k++) {
+    u = x * x;
+    v = y * y;
+    y = 2.0 * x * y + b;
+    x = u - v + a;
+    if(u + v > bail)
+      return(0);
+  }
+  return(1);
+}
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+/* Compute one tile of the atlas.  Tiles never overlap, so they can
+   be written into the atlas by different threads. */
+
+static void atlas_tile(int tile, void *arg)
+{
+  int row, col, j;
+  double a, b;
+
+  row = tile / acols;
+  col = tile % acols;
+  a = culx + col * atlas_cinc;
+  b = culy - row * atlas_cinc;
+  if(!connected(a, b))
+    return;
+  for(j = 0; j < atlas_th; j++)
+    atlas_escape(ulx, uly, atlas_inc, a, b, 0, 1, j, atlas_tw,
+                 atlas + (row * atlas_th + j) * width + col * atlas_tw);
+}
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+static void render_atlas(void)
+{
+  int i, j;
+
+  atlas_tw = width / acols;
+  atlas_th = height / arows;
+  atlas_inc = (uly - lly) / MAX(atlas_th - 1, 1);
+  atlas_cinc = (arows > 1) ? (culy - clly) / (arows - 1) : 0.0;
+  atlas_escape = escape_kernel(ulx, uly, atlas_inc, atlas_tw, atlas_th);
+  atlas = xmalloc(sizeof(int) * width * height);
+  memset(atlas, 0, sizeof(int) * width * height);
+
+  parallel_tasks(acols * arows, threads, atlas_tile, NULL);
+
+  for(j = 0; j < height; j++)
+    for(i = 0; i < width; i++)
+      if(atlas[j * width + i] != 0)
+        plot_point(i, j, color(atlas[j * width + i]));
+  free(atlas);
+}
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
 int main(int argc, char **argv)
 {
   extern int plot_mag;
   extern int plot_inverse;
-  int i, j, k;
-  double inc, binc, a, b, u, v, w, x, y;
+  int i, j, *row;
+  double inc, binc;
+  ESCAPEFUNC escape;
 
   get_options(argc, argv, options, help_string);
 
+  /* Compute the size increment of a single pixel, and pick the kernel
+   * once for the whole image, which also checks -precision before
+   * anything is plotted.
+   */
+  inc = (uly - lly) / (height - 1);
+  escape = escape_kernel(ulx, uly, inc, width, height);
+
+  /* Every tile of an atlas must be at least one pixel. */
+  if(acols > 0 && arows > 0 && (acols > width || arows > height)) {
+    fprintf(stderr, "Atlas of %d x %d tiles does not fit in the plot.\n",
+            acols, arows);
+    exit(1);
+  }
+
   plot_mag = mag;
   plot_inverse = invert;
   plot_init(width, height, levels, term);
   plot_set_all(0);
 
-  /* Compute the size increment of a single pixel. */
-  inc = (uly - lly) / (height - 1);
+  if(acols > 0 && arows > 0) {
+    render_atlas();
+    plot_finish();
+    exit(0);
+  }
+  else if(miim)
+    render_miim(inc);
+  else if(prog)
+    render_progressive(escape, inc);
+  else {
+    row = xmalloc(sizeof(int) * width);
+
+    /* For each vertical line... */
+    for(j = 0; j < height; j++) {
 
-  /* For each vertical line... */
-  for(j = 0, y = uly; j < height; j++, y -= inc) {
-
-    /* For each  horizontal line... */
-    for(i = 0, x = ulx; i < width; i++, x += inc) {
-      a = x;
-      b = y;
-
-      /* Inner loop for the point (x, y). */
-      for(k = 1; k <= maxit; k++) {
-
-        /* The complex equation, which sets the updates to (a, b). */
-        u = a * a;
-        v = b * b;
-        w = 2.0 * a * b;
-        a = u - v + cr;
-        b = w + ci;
-
-        /* Check bailout condition, and plot as appropriate. */
-        if(u + v > bail) {
-          if(rev)
-            plot_point(i, j, -((k / idiv + (k % idiv) * (levels / idiv)) %
-                               levels) + levels - 1);
-          else
-            plot_point(i, j, (k / idiv + (k % idiv) *
-                              (levels / idiv)) % levels);
-          break;
-        }
-      }
+      /* Compute the whole horizontal line and plot the diverging points. */
+      escape(ulx, uly, inc, cr, ci, 0, 1, j, width, row);
+      for(i = 0; i < width; i++)
+        if(row[i] != 0)
+          plot_point(i, j, color(row[i]));
     }
+    free(row);
   }
 
   /* Show a box, if appropriate. */
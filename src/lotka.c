@@ -6,7 +6,10 @@
  * MISCELLANY
  *   The program uses a second-order Euler's method to perform the
  *   numerical integration, which is sufficient for simple tasks such
- *   as this.
+ *   as this.  With -method, any of the integrators in ode.c can be
+ *   used instead.  The adaptive ones, rk23 and rk45, pick their own
+ *   steps to keep the error below TOL, and -dt then only sets the
+ *   time between the points that are plotted or printed.
  * BUGS
  *   No sanity checks are performed to make sure that any of the
  *   options make sense.
@@ -29,7 +32,8 @@
 int points = 2500, seed = -1;
 double f0 = 1.0, s0 = 0.2;
 double dt = 0.1, a = 1.5, b = 1.5, c = 0.5, d = 1.5;
-char *term = NULL;
+char *term = NULL, *method = "euler";
+double tol = 1e-6;
 
 OPTION options[] = {
   { "-seed",   OPT_INT,     &seed,   "Seed for random parameters." },
@@ -41,6 +45,8 @@ OPTION options[] = {
   { "-c",      OPT_DOUBLE,  &c,      "Fish nutritional value." },
   { "-d",      OPT_DOUBLE,  &d,      "Shark death rate." },
   { "-dt",     OPT_DOUBLE,  &dt,     "Time step increment." },
+  { "-method", OPT_STRING,  &method, "euler, rk4, rk23, or rk45." },
+  { "-tol",    OPT_DOUBLE,  &tol,    "Error tolerance for rk23 and rk45." },
   { NULL,      OPT_NULL,    NULL,    NULL }
 };
 
@@ -64,24 +70,20 @@ void myfunc(double x, double y, double *xx, double *yy)
 
 /* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
 
-/* Perform one second-order Euler step. */
+/* The system in the form that the integrators in ode.c want. */
 
-void euler(double dt, double *x, double *y)
+void odefunc(double *s, double *ds)
 {
-  double x1, x2, y1, y2;
-  
-  myfunc(*x, *y, &x1, &y1);
-  myfunc(dt * x1 + *x, dt * y1 + *y, &x2, &y2);
-  *x += 0.5 * dt * (x1 + x2);
-  *y += 0.5 * dt * (y1 + y2);
+  myfunc(s[0], s[1], &ds[0], &ds[1]);
 }
 
 /* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
 
 int main(int argc, char **argv)
 {
-  double F, S;
+  double pop[2];
   int i;
+  ODE ode;
 
   get_options(argc, argv, options, help_string);
   
@@ -92,12 +94,16 @@ int main(int argc, char **argv)
     fprintf(stderr, "%f %f %f %f\n", a, b, c, d);
   }
 
-  F = f0; S = s0;
+  pop[0] = f0; pop[1] = s0;
+  ode_init(&ode, 2, odefunc, pop, dt, method, tol);
   for(i = 0; i < points; i++) {
-    euler(dt, &F, &S);
-    printf("% f\t% f\n", F, S);
-    F = F < 0 ? 0 : F;
-    S = S < 0 ? 0 : S;    
+    ode_solve(&ode, (i + 1) * dt, pop);
+    printf("% f\t% f\n", pop[0], pop[1]);
+    if(pop[0] < 0 || pop[1] < 0) {
+      pop[0] = MAX(pop[0], 0);
+      pop[1] = MAX(pop[1], 0);
+      ode_set(&ode, pop);
+    }
   }
 
   exit(0);
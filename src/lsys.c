@@ -2,7 +2,41 @@
 /* NAME
  *   lsys - builds an L-system fractal from multiple rules
  * NOTES
- *   None.
+ *   With -threads, the figure is cut into pieces that are drawn in
+ *   parallel.  The net motion of the turtle over the expansion of
+ *   each symbol at each depth is computed once and remembered, which
+ *   lets the turtle skip over the top levels of the figure and find
+ *   the state that each piece starts in without drawing anything.
+ *   Each thread buffers its lines and draws them into a private cover
+ *   of the plot when the buffer fills up, and the covers are merged
+ *   at the end; with a vector terminal (ps or svg), the threads take
+ *   turns with the plot routines instead.  Noise (-unoise) depends on
+ *   the order in which the whole figure is drawn, so figures with
+ *   noise are always drawn by a single thread.
+ *
+ *   With -memo, the bounding box of the lines drawn by each symbol at
+ *   each depth is remembered too, one box for each heading that the
+ *   turtle can have.  The bounds of the whole figure then come from
+ *   the boxes, so the figure is only walked once, and while drawing,
+ *   pieces that draw nothing are skipped and pieces that cannot
+ *   reach past a single pixel are drawn as one line from where the
+ *   piece starts to where it ends, which gives the same image as
+ *   drawing them in full.  This only works if the angle given by -da
+ *   divides a full turn, and if there is no noise; otherwise -memo is
+ *   ignored.
+ *
+ *   With -ensemble, that many instances of a noisy figure are drawn,
+ *   each with its own random number stream, and the image shows how
+ *   many of the instances cover each pixel.  The instances are split
+ *   among walkers that run in parallel, each counting in a histogram
+ *   of its own, and the histograms are summed and mapped onto LEVELS
+ *   gray levels at the end.  All instances share one scaling, which
+ *   comes from a first pass over all of them to find their bounds.
+ *
+ *   The rules are compiled into arrays of opcodes before anything is
+ *   drawn, and when -da divides a full turn, the sines and cosines of
+ *   every heading are kept in a table.  Lines are buffered and sent
+ *   to the plot routines in batches.
  * RULES
  *   The L-system rules should always take the form "x=..." where
  *   "x" is a letter and the remaining portion is a sequence of
@@ -77,6 +111,7 @@ more information on the format for legal rules. \
 
 double aa0 = 90.0, da = 90.0, ds = 1, unoise = 0.0;
 int width = 480, height = 480, border = 10, depth = 5, mag = 1, invert = 0;
+int threads = 1, memo = 0, ensemble = 0, levels = 2, logmap = 0;
 char *rules['z' - 'a' + 1], stubs[('z' - 'a' + 1) * 2], *axiom = "f";
 char *term = NULL;
 
@@ -99,6 +134,14 @@ OPTION options[] = {
   { "-inv",    OPT_SWITCH,  &invert, "Invert all colors?" },
   { "-mag",    OPT_INT,     &mag,    "Magnification factor." },
   { "-term",   OPT_STRING,  &term,   "How to plot points." },
+  { "-threads", OPT_INT,    &threads,
+    "Number of threads.  If zero, use all processors." },
+  { "-memo",   OPT_SWITCH,  &memo,
+    "Find the bounds without drawing and skip sub-pixel pieces?" },
+  { "-ensemble", OPT_INT,   &ensemble,
+    "If positive, plot the density of this many noisy instances." },
+  { "-levels", OPT_INT,     &levels, "Number of gray levels for -ensemble." },
+  { "-log",    OPT_SWITCH,  &logmap, "Map densities logarithmically?" },
   { NULL,      OPT_NULL,    NULL,    NULL }
 };
 
@@ -140,106 +183,868 @@ int rparse(char **argv, int argc, OPTION *options, int *cargc, int opt)
 
 /* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
 
-/* Some global variables that make life easier. X, y, a, s, represent the
-   current (x, y) position, angle, and scale.  The min and max variables
-   are to determing the plotting boundaries of the final fractal. */
+/* The state of the turtle: its (x, y) position, angle, and scale.  If
+   the turns can be looked up in a table, k is the index of the angle
+   among the HEADINGS different ones. */
+
+typedef struct TURTLE {
+  double x, y, a, s;
+  int k;
+} TURTLE;
+
+/* Rules are compiled into arrays of opcodes before they are used, so
+   that the characters of a rule are only looked at once.  The
+   opcodes are:
+
+     OP_END     the end of a rule or of a bracketed piece of one;
+     OP_LETTER  a letter, with ARG from 0 to 25;
+     OP_BAR     a '|' command;
+     OP_TURN    a turn of ARG (which may be negative) times DA; and
+     OP_PUSH    a '[', with ARG being how many opcodes to skip to get
+                past the matching ']'. */
+
+#define OP_END    0
+#define OP_LETTER 1
+#define OP_BAR    2
+#define OP_TURN   3
+#define OP_PUSH   4
+
+typedef struct OP {
+  int op, arg;
+} OP;
+
+/* The net effect of expanding a symbol on a turtle that starts at the
+   origin with an angle of zero and a scale of one: where it ends up,
+   and how far it has turned. */
+
+typedef struct MOTION {
+  double x, y, a;
+  int known;
+} MOTION;
+
+/* The bounding box of the lines drawn by the expansion of a symbol. */
+
+typedef struct BOX {
+  double minx, maxx, miny, maxy;
+  int known;
+} BOX;
+
+/* Number of line segments to buffer before plotting. */
+
+#define BATCH 1024
+
+/* Where the results of one traversal go.  If calcbounds is set, then
+   the plotting bounds are computed.  Otherwise, the figure is plotted
+   through the buffer of segments, or, if hist is not NULL, counted in
+   the density histogram as instance number inst.  The buffered
+   segments go into cover if it is not NULL, and into the plot
+   otherwise.  The random numbers for the noise come from rs, or from
+   random_range() if it is NULL. */
+
+typedef struct CONTEXT {
+  int calcbounds, maxx, maxy, minx, miny;
+  double seg[4 * BATCH];
+  int n;
+  unsigned char *cover;
+  RANDSTREAM *rs;
+  unsigned int *hist;
+  int *last, inst;
+} CONTEXT;
+
+/* A symbol to be expanded by one of the parallel tasks, compiled into
+   a program of its own, with its depth and the state of the turtle
+   when it is reached. */
+
+typedef struct TASK {
+  OP prog[2];
+  int d;
+  TURTLE t;
+} TASK;
+
+/* Make a task for at least this many subtrees per thread. */
+
+#define TASKS_PER_THREAD 8
+
+/* The largest number of headings to keep tables for. */
+
+#define MAXHEADINGS 360
+
+/* The min and max variables are to determing the plotting boundaries
+   of the final fractal. */
 
-double x, y, a, s;
 int maxx = -10000, maxy = -10000, minx = 10000, miny = 10000;
 
-/* This function is essentially a turtle graphics interpreter.  If 
-   calcbounds is set, then the plotting bounds are computed.  Otherwise,
-   the figure is plotted. */
+OP *progs['z' - 'a' + 1], *axprog;
+MOTION *motions;
+BOX *boxes = NULL;
+TASK *tasks;
+int ntasks, headings = 0;
+double *sintab, *costab;
 
-void compute_figure(char *rule, int d, int calcbounds)
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+/* Compile RULE into opcodes.  Digits are folded into the turn that
+   follows them, just as the interpreter used to carry them along. */
+
+static OP *compile_rule(char *rule)
 {
-  double sx, sy, sa, ss;  /* Used to save states between calls. */
-  int len, i, ax, ay, bx, by, num; /* Mostly temporary variables. */
+  int len, i, n, num, sp, *stack;
+  OP *prog;
 
-  num = 0;
   len = (rule != NULL) ? strlen(rule) : 0;
-  
-  /* For each character in the rule ... */
+  prog = xmalloc(sizeof(OP) * (len + 1));
+  stack = xmalloc(sizeof(int) * (len + 1));
+  n = num = sp = 0;
   for(i = 0; i < len; i++) {
+    if(rule[i] >= 'a' && rule[i] <= 'z') {
+      prog[n].op = OP_LETTER;
+      prog[n++].arg = rule[i] - 'a';
+    }
+    else if(rule[i] == '|') {
+      prog[n].op = OP_BAR;
+      prog[n++].arg = 0;
+    }
+    else if(rule[i] >= '0' && rule[i] <= '9')
+      num = num * 10 + (rule[i] - '0');
+    else if(rule[i] == '+' || rule[i] == '-') {
+      num = (num == 0) ? 1 : num;
+      prog[n].op = OP_TURN;
+      prog[n++].arg = (rule[i] == '+') ? num : -num;
+      num = 0;
+    }
+    else if(rule[i] == '[') {
+      stack[sp++] = n;
+      prog[n].op = OP_PUSH;
+      prog[n++].arg = 0;
+      num = 0;
+    }
+    else if(rule[i] == ']') {
+      prog[n].op = OP_END;
+      prog[n++].arg = 0;
+      /* An unmatched ']' ends the whole rule. */
+      if(sp == 0)
+        break;
+      sp--;
+      prog[stack[sp]].arg = n - stack[sp];
+    }
+  }
+  prog[n].op = OP_END;
+  prog[n].arg = 0;
+
+  /* A '[' that is never closed skips to the very end. */
+  while(sp > 0) {
+    sp--;
+    prog[stack[sp]].arg = n - stack[sp];
+  }
+  free(stack);
+  return(prog);
+}
 
-    /* If it is a letter or a '|' ... */
-    if((rule[i] >= 'a' && rule[i] <= 'z') || rule[i] == '|') {
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
 
-      /* For any letter, reduce the scale and recursively expand things
-       * by expanding the letter's rule.  Restore the scale afterwards.
-       */
-      if(d > 0 && rule[i] != '|') {
-        ss = s; s *= ds;
-        compute_figure(rules[rule[i] - 'a'], d - 1, calcbounds);
-        s = ss;
-      }
+/* Returns the symbol of a letter or '|' opcode. */
+
+static char op_symbol(OP *op)
+{
+  return((op->op == OP_BAR) ? '|' : op->arg + 'a');
+}
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+/* Returns the index of the heading A, which is a0 plus a whole number
+   of turns, among the HEADINGS different ones. */
+
+static int heading(double a)
+{
+  int k;
+
+  k = floor((a - aa0) / da + 0.5);
+  k %= headings;
+  return((k < 0) ? k + headings : k);
+}
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+/* Turn the turtle by N times DA. */
+
+static void turn(TURTLE *t, int n)
+{
+  t->a += n * da;
+  if(headings) {
+    t->k = (t->k + n) % headings;
+    t->k += (t->k < 0) ? headings : 0;
+  }
+}
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+/* Find where one step of the turtle would take it.  The random numbers
+   are only drawn when they are used, which keeps the parallel tasks
+   away from the shared random number generator. */
+
+static void step(TURTLE *t, RANDSTREAM *rs, double *sx, double *sy)
+{
+  if(unoise != 0 && rs) {
+    *sx = t->x + sin(t->a + unoise * random_stream_range(rs, -1.0, 1.0)) *
+      t->s;
+    *sy = t->y + cos(t->a + unoise * random_stream_range(rs, -1.0, 1.0)) *
+      t->s;
+  }
+  else if(unoise != 0) {
+    *sx = t->x + sin(t->a + unoise * random_range(-1.0, 1.0)) * t->s;
+    *sy = t->y + cos(t->a + unoise * random_range(-1.0, 1.0)) * t->s;
+  }
+  else if(headings) {
+    *sx = t->x + sintab[t->k] * t->s;
+    *sy = t->y + costab[t->k] * t->s;
+  }
+  else {
+    *sx = t->x + sin(t->a) * t->s;
+    *sy = t->y + cos(t->a) * t->s;
+  }
+}
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+/* Set up CTX for a traversal, with empty bounds and no buffered
+   segments.  HIST and LAST are the histogram and the record of which
+   instance last counted each pixel, or NULL to plot the lines. */
+
+static void context_init(CONTEXT *ctx, int calcbounds, RANDSTREAM *rs,
+                         unsigned int *hist, int *last)
+{
+  ctx->calcbounds = calcbounds;
+  ctx->maxx = ctx->maxy = -10000;
+  ctx->minx = ctx->miny = 10000;
+  ctx->n = 0;
+  ctx->cover = NULL;
+  ctx->rs = rs;
+  ctx->hist = hist;
+  ctx->last = last;
+  ctx->inst = 0;
+}
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+/* Plot the buffered segments, either into the cover of CTX or, taking
+   turns with other tasks, into the plot. */
 
-      /* It is a command that requires movement of some form. */
-      else if(rule[i] == 'f' || rule[i] == 'g' || rule[i] == '|') {
-
-        /* Calculate where we should step. */
-        sx = x + sin(a + unoise * random_range(-1.0, 1.0)) * s;
-        sy = y + cos(a + unoise * random_range(-1.0, 1.0)) * s;
-
-        /* We need to plot any 'f' or '|' commands ... */
-        if(rule[i] == 'f' || rule[i] == '|') {
-          /* Calculate the line segments two endpoints properly scaled. */
-          ax = width * x + 0.5;
-          ay = height * y + 0.5;
-          bx = width * sx + 0.5;
-          by = height * sy + 0.5;
-
-          /* Save the boundaries if appropriate ... */
-          if(calcbounds) {
-            maxx = MAX(maxx, MAX(ax, bx));
-            maxy = MAX(maxy, MAX(height - ay, height - by));
-            minx = MIN(minx, MIN(ax, bx));
-            miny = MIN(miny, MIN(height - ay, height - by));
-          }
-          /* ... or plot the line. */
-          else
-            plot_line(ax, height - ay, bx, height - by, 1);
+static void flush_segments(CONTEXT *ctx)
+{
+  if(ctx->cover)
+    plot_cover_lines(ctx->cover, ctx->n, ctx->seg);
+  else {
+    parallel_lock();
+    plot_lines(ctx->n, ctx->seg, 1);
+    parallel_unlock();
+  }
+  ctx->n = 0;
+}
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+/* Count the pixels of the line from (ax, ay) to (bx, by), which are
+   scaled just as they would be by plot_line(), in the histogram of
+   CTX.  Each pixel is counted at most once per instance. */
+
+static void density_line(CONTEXT *ctx, int ax, int ay, int bx, int by)
+{
+  extern double plot_xmin, plot_xmax, plot_ymin, plot_ymax;
+  double x1, y1, x2, y2, t, dt;
+  int len, i, px, py;
+
+  x1 = (ax - plot_xmin) / (plot_xmax - plot_xmin) * width;
+  x2 = (bx - plot_xmin) / (plot_xmax - plot_xmin) * width;
+  y1 = ((plot_ymin - ay) / (plot_ymax - plot_ymin) + 1.0) * height;
+  y2 = ((plot_ymin - by) / (plot_ymax - plot_ymin) + 1.0) * height;
+  len = MAX(ABS((int) x1 - (int) x2), ABS((int) y1 - (int) y2));
+  dt = (len > 0) ? 1.0 / len : 0.0;
+  for(i = 0, t = 0.0; i <= len; i++, t += dt) {
+    px = t * (int) x2 + (1.0 - t) * (int) x1 + 0.5;
+    py = t * (int) y2 + (1.0 - t) * (int) y1 + 0.5;
+    px = (px == width) ? px - 1 : px;
+    py = (py == height) ? py - 1 : py;
+    if(px >= 0 && px < width && py >= 0 && py < height &&
+       ctx->last[py * width + px] != ctx->inst) {
+      ctx->last[py * width + px] = ctx->inst;
+      ctx->hist[py * width + px]++;
+    }
+  }
+}
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+/* The column and row of the plot that the turtle position X or Y ends
+   up in, rounded by add_segment() and then scaled exactly as the plot
+   routines do it.  Both only ever grow (or shrink) with their
+   argument, so the pixels of the corners of a box are the extremes of
+   the pixels of everything in it. */
+
+static int plot_column(double x)
+{
+  extern double plot_xmin, plot_xmax;
+  int ax, px;
+
+  ax = width * x + 0.5;
+  px = (ax - plot_xmin) / (plot_xmax - plot_xmin) * width;
+  return((px == width) ? px - 1 : px);
+}
+
+static int plot_row(double y)
+{
+  extern double plot_ymin, plot_ymax;
+  int ay, py;
+
+  ay = height * y + 0.5;
+  py = ((plot_ymin - (height - ay)) / (plot_ymax - plot_ymin) + 1.0) *
+    height;
+  return((py == height) ? py - 1 : py);
+}
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+/* Save the line from (x1, y1) to (x2, y2), or just grow the bounds
+   if that is what CTX is for. */
+
+static void add_segment(CONTEXT *ctx, double x1, double y1,
+                        double x2, double y2)
+{
+  int ax, ay, bx, by;
+  double *seg;
+
+  /* Calculate the line segments two endpoints properly scaled. */
+  ax = width * x1 + 0.5;
+  ay = height * y1 + 0.5;
+  bx = width * x2 + 0.5;
+  by = height * y2 + 0.5;
+
+  /* Save the boundaries if appropriate ... */
+  if(ctx->calcbounds) {
+    ctx->maxx = MAX(ctx->maxx, MAX(ax, bx));
+    ctx->maxy = MAX(ctx->maxy, MAX(height - ay, height - by));
+    ctx->minx = MIN(ctx->minx, MIN(ax, bx));
+    ctx->miny = MIN(ctx->miny, MIN(height - ay, height - by));
+  }
+  /* ... or count the line in the histogram ... */
+  else if(ctx->hist)
+    density_line(ctx, ax, height - ay, bx, height - by);
+  /* ... or buffer the line. */
+  else {
+    seg = ctx->seg + 4 * ctx->n;
+    seg[0] = ax; seg[1] = height - ay;
+    seg[2] = bx; seg[3] = height - by;
+    if(++ctx->n == BATCH)
+      flush_segments(ctx);
+  }
+}
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+static void apply_motion(TURTLE *t, MOTION *m, double scale);
+static MOTION *symbol_motion(char c, int d);
+static BOX *symbol_box(char c, int d, int k);
+
+/* This function is essentially a turtle graphics interpreter that runs
+   the compiled rule PROG, moving the turtle T and sending its lines to
+   CTX.  With -memo, pieces of the figure that draw nothing are
+   skipped, and pieces whose lines, start, and end all land in a
+   single pixel of the plot are drawn as one line from the start to
+   the end, which covers just that pixel, as the whole piece would. */
+
+void compute_figure(OP *prog, int d, TURTLE *t, CONTEXT *ctx)
+{
+  double sx, sy, sa, ss;  /* Used to save states between calls. */
+  int sk, px, py;
+  BOX *b;
+  TURTLE e;
+
+  /* For each opcode in the rule ... */
+  for(; prog->op != OP_END; prog++) {
+
+    /* For any letter, reduce the scale and recursively expand things
+     * by expanding the letter's rule.  Restore the scale afterwards.
+     */
+    if(prog->op == OP_LETTER && d > 0) {
+      if(boxes && !ctx->calcbounds) {
+        b = symbol_box(op_symbol(prog), d, t->k);
+        if(b->minx > b->maxx) {
+          apply_motion(t, symbol_motion(op_symbol(prog), d), 1.0);
+          continue;
+        }
+        e = *t;
+        apply_motion(&e, symbol_motion(op_symbol(prog), d), 1.0);
+        px = plot_column(t->x + t->s * b->minx);
+        py = plot_row(t->y + t->s * b->miny);
+        if(plot_column(t->x + t->s * b->maxx) == px &&
+           plot_row(t->y + t->s * b->maxy) == py &&
+           plot_column(t->x) == px && plot_row(t->y) == py &&
+           plot_column(e.x) == px && plot_row(e.y) == py) {
+          add_segment(ctx, t->x, t->y, e.x, e.y);
+          *t = e;
+          continue;
         }
-        /* Set the current position to the new position calculated. */
-        x = sx; y = sy;
       }
+      ss = t->s; t->s *= ds;
+      compute_figure(progs[prog->arg], d - 1, t, ctx);
+      t->s = ss;
     }
-    /* If it is a number digit, then calculate the num for future use. */
-    else if(rule[i] >= '0' && rule[i] <= '9')
-      num = num * 10 + (rule[i] - '0');
 
-    /* If it is a turn request ... */
-    else if(rule[i] == '+' || rule[i] == '-') {
-      /* ... then use any saved num and modify the angle. */
-      num = (num == 0) ? 1 : num;
-      a += (rule[i] == '+') ? num * da : num * -da;
-      num = 0;
+    /* It is a command that requires movement of some form. */
+    else if(prog->op == OP_BAR || (prog->op == OP_LETTER &&
+            (prog->arg == 'f' - 'a' || prog->arg == 'g' - 'a'))) {
+      step(t, ctx->rs, &sx, &sy);
+
+      /* We need to plot any 'f' or '|' commands. */
+      if(prog->op == OP_BAR || prog->arg == 'f' - 'a')
+        add_segment(ctx, t->x, t->y, sx, sy);
+
+      /* Set the current position to the new position calculated. */
+      t->x = sx; t->y = sy;
     }
 
+    /* If it is a turn request, then modify the angle. */
+    else if(prog->op == OP_TURN)
+      turn(t, prog->arg);
+
     /* If it is a state save request ... */
-    else if(rule[i] == '[') {
+    else if(prog->op == OP_PUSH) {
       /* ... save the state on the stack, ... */
-      sx = x; sy = y; sa = a, ss = s;
-      /* ... recursively call on the next characters, ... */
-      compute_figure(rule + i + 1, d, calcbounds);
+      sx = t->x; sy = t->y; sa = t->a, ss = t->s; sk = t->k;
+      /* ... recursively call on the next opcodes, ... */
+      compute_figure(prog + 1, d, t, ctx);
       /* ... and restore the state. */
-      x = sx; y = sy; a = sa; s = ss; num = 1;
-
-      /* Everything between the '[' and ']' characters has been interpreted,
-       * so gobble up everything until we see a properly nested pair of
-       * brackets.
-       */
-      do {
-        i++;
-        num = num + ((rule[i] == '[') ? 1 : (rule[i] == ']') ? -1 : 0);
-      } while(num != 0);
+      t->x = sx; t->y = sy; t->a = sa; t->s = ss; t->k = sk;
+
+      /* Skip everything up to the matching ']'. */
+      prog += prog->arg - 1;
     }
+  }
+}
 
-    /* If it is a state restore request, then just return.  The
-     * previous state will be restored on the caller's side.
-     */
-    else if(rule[i] == ']') return;
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+/* Move the turtle as if it had carried out the motion M at SCALE times
+   its own scale. */
+
+static void apply_motion(TURTLE *t, MOTION *m, double scale)
+{
+  double c, s;
+
+  c = cos(t->a) * t->s * scale;
+  s = sin(t->a) * t->s * scale;
+  t->x += m->x * c + m->y * s;
+  t->y += m->y * c - m->x * s;
+  t->a += m->a;
+  if(headings)
+    t->k = heading(t->a);
+}
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+/* Set the turtle to its starting state at (x, y) with heading K and a
+   scale of one. */
+
+static void start_turtle(TURTLE *t, double x, double y, int k)
+{
+  t->x = x; t->y = y;
+  t->a = aa0 + k * da;
+  t->s = 1.0;
+  t->k = k;
+}
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+/* Find the net effect of running PROG at depth D.  This mirrors
+   compute_figure(), but the expansion of each symbol is looked up
+   rather than walked. */
+
+static void rule_motion(OP *prog, int d, MOTION *m)
+{
+  TURTLE t;
+
+  start_turtle(&t, 0.0, 0.0, 0);
+  t.a = 0.0;
+  for(; prog->op != OP_END; prog++) {
+    if(prog->op == OP_LETTER || prog->op == OP_BAR)
+      apply_motion(&t, symbol_motion(op_symbol(prog), d), 1.0);
+    else if(prog->op == OP_TURN)
+      t.a += prog->arg * da;
+    /* Brackets leave the turtle where it was. */
+    else if(prog->op == OP_PUSH)
+      prog += prog->arg - 1;
   }
+  m->x = t.x;
+  m->y = t.y;
+  m->a = t.a;
+}
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+/* Returns the net effect of the symbol C (a letter or '|') at depth D.
+   Each one is computed only once, so this takes time proportional to
+   the depth and not to the size of the figure.  This is only valid
+   without noise. */
+
+static MOTION *symbol_motion(char c, int d)
+{
+  static MOTION step = { 0.0, 1.0, 0.0, 1 }, none = { 0.0, 0.0, 0.0, 1 };
+  MOTION *m;
+
+  if(c == '|')
+    return(&step);
+  if(d == 0)
+    return((c == 'f' || c == 'g') ? &step : &none);
+  m = &motions[(c - 'a') * (depth + 1) + d];
+  if(!m->known) {
+    rule_motion(progs[c - 'a'], d - 1, m);
+    m->x *= ds;
+    m->y *= ds;
+    m->known = 1;
+  }
+  return(m);
+}
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+/* Add the point (x, y) to the box B. */
+
+static void grow_box(BOX *b, double x, double y)
+{
+  b->minx = MIN(b->minx, x);
+  b->maxx = MAX(b->maxx, x);
+  b->miny = MIN(b->miny, y);
+  b->maxy = MAX(b->maxy, y);
+}
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+/* Add the lines drawn by PROG at depth D to the box B, for a turtle
+   that starts at (x, y) with heading K and a scale of one.  This walks
+   the rule just like rule_motion() does, except that the contents of
+   brackets are walked as well. */
+
+static void rule_box(OP *prog, int d, int k, double x, double y, BOX *b)
+{
+  TURTLE t;
+  BOX *sb;
+
+  start_turtle(&t, x, y, k);
+  for(; prog->op != OP_END; prog++) {
+    if(prog->op == OP_LETTER && d > 0) {
+      sb = symbol_box(op_symbol(prog), d, t.k);
+      if(sb->minx <= sb->maxx) {
+        grow_box(b, t.x + sb->minx, t.y + sb->miny);
+        grow_box(b, t.x + sb->maxx, t.y + sb->maxy);
+      }
+    }
+    else if(prog->op == OP_BAR || (prog->op == OP_LETTER &&
+            prog->arg == 'f' - 'a')) {
+      grow_box(b, t.x, t.y);
+      grow_box(b, t.x + sintab[t.k], t.y + costab[t.k]);
+    }
+    if(prog->op == OP_LETTER || prog->op == OP_BAR)
+      apply_motion(&t, symbol_motion(op_symbol(prog), d), 1.0);
+    else if(prog->op == OP_TURN)
+      turn(&t, prog->arg);
+    else if(prog->op == OP_PUSH) {
+      rule_box(prog + 1, d, t.k, t.x, t.y, b);
+      prog += prog->arg - 1;
+    }
+  }
+}
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+/* Returns the bounding box of the lines drawn by the letter C at depth
+   D > 0, relative to a turtle at the origin with heading K and a scale
+   of one.  The box is empty (with minx > maxx) if nothing is drawn.
+   Like the motions, each box is computed only once. */
+
+static BOX *symbol_box(char c, int d, int k)
+{
+  BOX *b;
+
+  b = &boxes[((c - 'a') * (depth + 1) + d) * headings + k];
+  if(!b->known) {
+    b->minx = b->miny = HUGE_VAL;
+    b->maxx = b->maxy = -HUGE_VAL;
+    rule_box(progs[c - 'a'], d - 1, k, 0.0, 0.0, b);
+    b->minx *= ds; b->maxx *= ds;
+    b->miny *= ds; b->maxy *= ds;
+    b->known = 1;
+  }
+  return(b);
+}
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+/* Compile the rules and get space for the remembered motions.  If DA
+   divides a full turn into at most MAXHEADINGS headings, and there is
+   no noise, then steps take their sines and cosines from tables, and
+   with -memo the boxes, which depend on the heading, are remembered
+   as well. */
+
+static void init_memo(void)
+{
+  int i, n;
+
+  for(i = 0; i < ('z' - 'a' + 1); i++)
+    progs[i] = compile_rule(rules[i]);
+  axprog = compile_rule(axiom);
+
+  n = ('z' - 'a' + 1) * (depth + 1);
+  motions = xmalloc(sizeof(MOTION) * n);
+  memset(motions, 0, sizeof(MOTION) * n);
+  if(unoise == 0 && da != 0) {
+    headings = floor(2 * M_PI / ABS(da) + 0.5);
+    if(headings < 1 || headings > MAXHEADINGS ||
+       ABS(headings * ABS(da) - 2 * M_PI) > 1e-9)
+      headings = 0;
+  }
+  if(headings) {
+    sintab = xmalloc(sizeof(double) * headings);
+    costab = xmalloc(sizeof(double) * headings);
+    for(i = 0; i < headings; i++) {
+      sintab[i] = sin(aa0 + i * da);
+      costab[i] = cos(aa0 + i * da);
+    }
+  }
+  if(headings && memo) {
+    boxes = xmalloc(sizeof(BOX) * n * headings);
+    memset(boxes, 0, sizeof(BOX) * n * headings);
+  }
+}
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+/* Cut the figure into tasks.  Symbols are expanded in place down to
+   LEVEL more levels, and every symbol that is left becomes a task
+   (if TASKS is not NULL) that starts wherever the turtle is when it
+   reaches the symbol.  The turtle then skips over the symbol with
+   its net motion.  NTASKS counts the tasks. */
+
+static void split_figure(OP *prog, int d, TURTLE *t, int level)
+{
+  double sx, sy, sa, ss;
+  int sk;
+
+  for(; prog->op != OP_END; prog++) {
+    if(prog->op == OP_LETTER && d > 0 && level > 0) {
+      ss = t->s; t->s *= ds;
+      split_figure(progs[prog->arg], d - 1, t, level - 1);
+      t->s = ss;
+    }
+    else if(prog->op == OP_LETTER || prog->op == OP_BAR) {
+      if(tasks) {
+        tasks[ntasks].prog[0] = *prog;
+        tasks[ntasks].prog[1].op = OP_END;
+        tasks[ntasks].prog[1].arg = 0;
+        tasks[ntasks].d = d;
+        tasks[ntasks].t = *t;
+      }
+      ntasks++;
+      apply_motion(t, symbol_motion(op_symbol(prog), d), 1.0);
+    }
+    else if(prog->op == OP_TURN)
+      turn(t, prog->arg);
+    else if(prog->op == OP_PUSH) {
+      sx = t->x; sy = t->y; sa = t->a, ss = t->s; sk = t->k;
+      split_figure(prog + 1, d, t, level);
+      t->x = sx; t->y = sy; t->a = sa; t->s = ss; t->k = sk;
+      prog += prog->arg - 1;
+    }
+  }
+}
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+/* Expand one task.  ARG is nonzero to compute bounds instead of
+   plotting, in which case the bounds are merged into the globals.
+   Otherwise, the task draws into a cover if there are any. */
+
+static int covers = 0;
+
+static void figure_task(int task, void *arg)
+{
+  CONTEXT *ctx;
+  TURTLE t;
+
+  ctx = xmalloc(sizeof(CONTEXT));
+  context_init(ctx, arg != NULL, NULL, NULL, NULL);
+  if(!ctx->calcbounds && covers)
+    ctx->cover = plot_cover_take();
+  t = tasks[task].t;
+  compute_figure(tasks[task].prog, tasks[task].d, &t, ctx);
+  if(ctx->calcbounds) {
+    parallel_lock();
+    maxx = MAX(maxx, ctx->maxx);
+    maxy = MAX(maxy, ctx->maxy);
+    minx = MIN(minx, ctx->minx);
+    miny = MIN(miny, ctx->miny);
+    parallel_unlock();
+  }
+  else {
+    flush_segments(ctx);
+    if(ctx->cover) plot_cover_give(ctx->cover);
+  }
+  free(ctx);
+}
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+/* Cut the figure into enough tasks to keep every thread busy. */
+
+static void make_tasks(void)
+{
+  TURTLE t;
+  int level, want;
+
+  want = TASKS_PER_THREAD * parallel_threads(threads);
+  tasks = NULL;
+  for(level = 0; ; level++) {
+    start_turtle(&t, 0.0, 0.0, 0);
+    ntasks = 0;
+    split_figure(axprog, depth, &t, level);
+    if(ntasks >= want || level >= depth)
+      break;
+  }
+  tasks = xmalloc(sizeof(TASK) * MAX(ntasks, 1));
+  start_turtle(&t, 0.0, 0.0, 0);
+  ntasks = 0;
+  split_figure(axprog, depth, &t, level);
+}
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+/* Set the plotting range so that the bounds fit in the plot with the
+   same scaling in both directions, leaving room for the border. */
+
+static void set_range(void)
+{
+  double xs, ys, xo, yo;
+
+  /* Calculate two possible scalings, but pick the one that is biggest
+   * for both so that the scaling is identical.
+   */
+  xs = (maxx - minx) / (double) width;
+  ys = (maxy - miny) / (double) height;
+  if(ys > xs) xs = ys; else ys = xs;
+
+  /* Calculate offsets to maintain a correct aspect ratio with respect
+   * to the screen width, height, and desired border.
+   */
+  if((maxx - minx) > (maxy - miny)) {
+    yo = (maxx - minx - maxy + miny) - 2 * border * ys;
+    xo = -2 * border * xs;
+  }
+  else {
+    xo = (maxy - miny - maxx + minx) - 2 * border * xs;
+    yo = -2 * border * ys;
+  }
+
+  /* Set the plotting ranges appropriately. */
+  plot_set_range(xs * width + minx - xo / 2 - 0.5,
+                 maxx - xs * width + xo / 2 + 0.5,
+                 ys * height + miny - yo / 2 - 0.5,
+                 maxy - ys * height + yo / 2 + 0.5);
+}
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+/* For -ensemble, one histogram (and a record of which instance last
+   counted each pixel) per walker. */
+
+static unsigned int **ehist;
+static int **elast, walkers;
+
+/* Run the instances that belong to walker w, each with its own random
+   number stream.  ARG is nonzero to compute bounds, which are merged
+   into the globals, and otherwise the instances are counted in the
+   walker's histogram. */
+
+static void ensemble_task(int w, void *arg)
+{
+  RANDSTREAM rs;
+  CONTEXT *ctx;
+  TURTLE t;
+  int i;
+
+  ctx = xmalloc(sizeof(CONTEXT));
+  if(arg != NULL)
+    context_init(ctx, 1, &rs, NULL, NULL);
+  else {
+    context_init(ctx, 0, &rs, ehist[w], elast[w]);
+    memset(ctx->hist, 0, sizeof(unsigned int) * width * height);
+    for(i = 0; i < width * height; i++)
+      ctx->last[i] = -1;
+  }
+  for(i = w; i < ensemble; i += walkers) {
+    random_stream_init(&rs, 0, i);
+    ctx->inst = i;
+    start_turtle(&t, 0.0, 0.0, 0);
+    compute_figure(axprog, depth, &t, ctx);
+  }
+  if(ctx->calcbounds) {
+    parallel_lock();
+    maxx = MAX(maxx, ctx->maxx);
+    maxy = MAX(maxy, ctx->maxy);
+    minx = MIN(minx, ctx->minx);
+    miny = MIN(miny, ctx->miny);
+    parallel_unlock();
+  }
+  free(ctx);
+}
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+/* Plot the density of ENSEMBLE instances of the figure.  The bounds
+   are the union of the bounds of all of the instances, which takes a
+   first pass over all of them. */
+
+static void plot_ensemble(void)
+{
+  unsigned int *h, hmax;
+  double scale;
+  int i, w, val;
+
+  walkers = MIN(parallel_threads(threads), ensemble);
+  ehist = xmalloc(sizeof(unsigned int *) * walkers);
+  elast = xmalloc(sizeof(int *) * walkers);
+  for(w = 0; w < walkers; w++) {
+    ehist[w] = xmalloc(sizeof(unsigned int) * width * height);
+    elast[w] = xmalloc(sizeof(int) * width * height);
+  }
+
+  parallel_tasks(walkers, threads, ensemble_task, &walkers);
+  set_range();
+  parallel_tasks(walkers, threads, ensemble_task, NULL);
+
+  /* Merge the histograms into the first one. */
+  h = ehist[0];
+  for(w = 1; w < walkers; w++) {
+    for(i = 0; i < width * height; i++)
+      h[i] += ehist[w][i];
+    free(ehist[w]);
+  }
+  for(w = 0; w < walkers; w++)
+    free(elast[w]);
+  for(i = 0, hmax = 0; i < width * height; i++)
+    hmax = MAX(hmax, h[i]);
+
+  /* Map the counts to gray levels. */
+  if(logmap)
+    scale = (levels - 1) / log(1.0 + hmax);
+  else
+    scale = (double) (levels - 1) / hmax;
+  plot_set_range(0, width - 1, height - 1, 0);
+  for(i = 0; i < width * height; i++)
+    if(h[i] > 0) {
+      val = scale * (logmap ? log(1.0 + h[i]) : h[i]);
+      plot_point(i % width, i / width, MAX(val, 1));
+    }
+  free(h);
+  free(ehist);
+  free(elast);
 }
 
 /* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
@@ -248,8 +1053,10 @@ int main(int argc, char **argv)
 { 
   extern int plot_mag;
   extern int plot_inverse;
-  double xs, ys, xo, yo;
-  int i, len;
+  BOX b;
+  int i, len, parallel;
+  CONTEXT *ctx = NULL;
+  TURTLE t;
 
   /* Set each rule to initially be defined as itself. */
   for(i = 0; i < ('z' - 'a' + 1); i++) {
@@ -271,43 +1078,64 @@ int main(int argc, char **argv)
   aa0 = aa0 * M_PI / 180.0;
   da = da * M_PI / 180.0;
   
-  plot_init(width, height, 2, term);
+  plot_init(width, height, (ensemble > 0) ? levels : 2, term);
   plot_set_all(0);
 
-  x = 0; y = 0; a = aa0; s = 1;
-  srandom(0);
-  /* Calculate the bounding box size. */
-  compute_figure(axiom, depth, 1);
-
-  /* Calculate two possible scalings, but pick the one that is biggest
-   * for both so that the scaling is identical.
-   */
-  xs = (maxx - minx) / (double) width;
-  ys = (maxy - miny) / (double) height;
-  if(ys > xs) xs = ys; else ys = xs;
+  if(ensemble > 0) {
+    init_memo();
+    plot_ensemble();
+    plot_finish();
+    exit(0);
+  }
 
-  /* Calculate offsets to maintain a correct aspect ratio with respect
-   * to the screen width, height, and desired border.
+  /* Calculate the bounding box size, either from the remembered boxes,
+   * or by walking the figure, in parallel if we can.
    */
-  if((maxx - minx) > (maxy - miny)) {
-    yo = (maxx - minx - maxy + miny) - 2 * border * ys;
-    xo = -2 * border * xs;
+  parallel = (threads != 1 && unoise == 0);
+  init_memo();
+  if(parallel)
+    make_tasks();
+  if(boxes) {
+    b.minx = b.miny = HUGE_VAL;
+    b.maxx = b.maxy = -HUGE_VAL;
+    rule_box(axprog, depth, 0, 0.0, 0.0, &b);
+    minx = (int) (width * b.minx + 0.5);
+    maxx = (int) (width * b.maxx + 0.5);
+    miny = height - (int) (height * b.maxy + 0.5);
+    maxy = height - (int) (height * b.miny + 0.5);
   }
+  else if(parallel)
+    parallel_tasks(ntasks, threads, figure_task, &parallel);
   else {
-    xo = (maxy - miny - maxx + minx) - 2 * border * xs;
-    yo = -2 * border * ys;
+    ctx = xmalloc(sizeof(CONTEXT));
+    context_init(ctx, 1, NULL, NULL, NULL);
+    start_turtle(&t, 0.0, 0.0, 0);
+    srandom(0);
+    compute_figure(axprog, depth, &t, ctx);
+    maxx = ctx->maxx; maxy = ctx->maxy;
+    minx = ctx->minx; miny = ctx->miny;
   }
 
-  /* Set the plotting ranges appropriately. */
-  plot_set_range(xs * width + minx - xo / 2 - 0.5,
-                 maxx - xs * width + xo / 2 + 0.5,
-                 ys * height + miny - yo / 2 - 0.5,
-                 maxy - ys * height + yo / 2 + 0.5);
+  set_range();
 
-  x = 0; y = 0; a = aa0; s = 1;
-  srandom(0);
   /* Finally, plot the fractal. */
-  compute_figure(axiom, depth, 0);
+  if(parallel) {
+    covers = plot_vector ? 0 : MIN(parallel_threads(threads), ntasks);
+    if(covers)
+      plot_covers_init(covers);
+    parallel_tasks(ntasks, threads, figure_task, NULL);
+    if(covers)
+      plot_covers_finish(1);
+  }
+  else {
+    if(ctx == NULL)
+      ctx = xmalloc(sizeof(CONTEXT));
+    context_init(ctx, 0, NULL, NULL, NULL);
+    start_turtle(&t, 0.0, 0.0, 0);
+    srandom(0);
+    compute_figure(axprog, depth, &t, ctx);
+    flush_segments(ctx);
+  }
 
   plot_finish();
   exit(0);
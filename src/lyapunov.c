@@ -0,0 +1,197 @@
+
+/* NAME
+ *   lyapunov.c - map the largest Lyapunov exponent of a flow
+ * NOTES
+ *   This file is written in such a way that it should be included in
+ *   the other programs that need it, and not compiled directly.  It
+ *   scans a grid of values of two of the parameters or initial values
+ *   of a three-dimensional system, and plots the largest Lyapunov
+ *   exponent at each point of the grid as a gray level, so chaotic
+ *   regions (positive exponents) show up bright and periodic ones
+ *   dark.  Before including it, the program must define FLOW, as for
+ *   ensemble.c, and TANGENT(x, y, z, a, b, c, u, v, w, du, dv, dw),
+ *   which sets (DU, DV, DW) to the Jacobian of the system at (X, Y,
+ *   Z) times the vector (U, V, W).  It also expects the globals
+ *   width, height, skip, points, dt, xx0, yy0, zz0, data, format,
+ *   levels, threads, term, invert, and mag.  LYAPUNOV_OPTIONS goes in
+ *   the option table.
+ *
+ *   For each cell, the trajectory and a tangent vector are integrated
+ *   together with the second-order Euler's method, and the tangent
+ *   vector is brought back to unit length after every step.  The
+ *   exponent is the average logarithm of the growth over POINTS steps
+ *   after the first SKIP.  The rows of the grid are divided among
+ *   THREADS threads.
+ *
+ *   The ranges of the scanned values default to half to one and a
+ *   half times their values.  The gray levels run from LMIN to LMAX,
+ *   which default to the smallest and largest exponents found, and
+ *   cells whose trajectory escapes are black.  With -data, the grid is
+ *   printed instead, one cell per line.
+ */
+
+int scan = 0;
+double sxmin = 0, sxmax = 0, symin = 0, symax = 0, lmin = 0, lmax = 0;
+char *scanx = NULL, *scany = NULL;
+
+#define LYAPUNOV_OPTIONS \
+  { "-scan",    OPT_SWITCH, &scan,    "Map Lyapunov exponents?" }, \
+  { "-sx",      OPT_STRING, &scanx,   "Value to scan horizontally." }, \
+  { "-sy",      OPT_STRING, &scany,   "Value to scan vertically." }, \
+  { "-sxmin",   OPT_DOUBLE, &sxmin,   "Smallest horizontal value." }, \
+  { "-sxmax",   OPT_DOUBLE, &sxmax,   "Largest horizontal value." }, \
+  { "-symin",   OPT_DOUBLE, &symin,   "Smallest vertical value." }, \
+  { "-symax",   OPT_DOUBLE, &symax,   "Largest vertical value." }, \
+  { "-lmin",    OPT_DOUBLE, &lmin,    "Exponent plotted as black." }, \
+  { "-lmax",    OPT_DOUBLE, &lmax,    "Exponent plotted as white." }
+
+/* The six values that can be scanned, which are the three parameters
+   followed by the initial state, the indices of the two that are,
+   and the exponents found. */
+
+static double scanvals[6];
+static int scanix, scaniy;
+static double *lyap;
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+/* Find NAME among the parameter names in NAMES (separated by spaces),
+   or the initial values x0, y0, and z0. */
+
+static int lyapunov_index(char *name, char *names)
+{
+  char *p = names;
+  int i, len = strlen(name);
+
+  for(i = 0; *p; i++) {
+    if(!strncmp(p, name, len) && (p[len] == ' ' || p[len] == 0))
+      return(i);
+    while(*p && *p != ' ') p++;
+    while(*p == ' ') p++;
+  }
+  if(!strcmp(name, "x0")) return(3);
+  if(!strcmp(name, "y0")) return(4);
+  if(!strcmp(name, "z0")) return(5);
+  fprintf(stderr, "Cannot scan \"%s\".\n", name);
+  exit(1);
+}
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+/* The largest Lyapunov exponent for the parameters and initial state
+   in V. */
+
+static double lyapunov_cell(double *v)
+{
+  double x = v[3], y = v[4], z = v[5];
+  double u, w, q, k1x, k1y, k1z, k2x, k2y, k2z, tx, ty, tz;
+  double m1u, m1w, m1q, m2u, m2w, m2q, tu, tw, tq, n, sum = 0;
+  int i;
+
+  u = w = q = 1 / sqrt(3.0);
+  for(i = 0; i < skip + points; i++) {
+    FLOW(x, y, z, v[0], v[1], v[2], k1x, k1y, k1z);
+    TANGENT(x, y, z, v[0], v[1], v[2], u, w, q, m1u, m1w, m1q);
+    tx = dt * k1x + x; ty = dt * k1y + y; tz = dt * k1z + z;
+    tu = dt * m1u + u; tw = dt * m1w + w; tq = dt * m1q + q;
+    FLOW(tx, ty, tz, v[0], v[1], v[2], k2x, k2y, k2z);
+    TANGENT(tx, ty, tz, v[0], v[1], v[2], tu, tw, tq, m2u, m2w, m2q);
+    x += 0.5 * dt * (k1x + k2x);
+    y += 0.5 * dt * (k1y + k2y);
+    z += 0.5 * dt * (k1z + k2z);
+    u += 0.5 * dt * (m1u + m2u);
+    w += 0.5 * dt * (m1w + m2w);
+    q += 0.5 * dt * (m1q + m2q);
+    n = sqrt(u * u + w * w + q * q);
+    if(!(n > 0 && n < HUGE_VAL)) return(HUGE_VAL);
+    u /= n; w /= n; q /= n;
+    if(i >= skip) sum += log(n);
+  }
+  return(sum / (points * dt));
+}
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+static void lyapunov_row(int j, void *arg)
+{
+  double v[6];
+  int i;
+
+  memcpy(v, scanvals, sizeof(v));
+  v[scaniy] = symax - (symax - symin) * j / MAX(height - 1, 1);
+  for(i = 0; i < width; i++) {
+    v[scanix] = sxmin + (sxmax - sxmin) * i / MAX(width - 1, 1);
+    lyap[j * width + i] = lyapunov_cell(v);
+  }
+}
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+/* Scan the grid, with A, B, and C as the parameters that are not
+   scanned, and NAMES as the names of the parameters that are used. */
+
+void lyapunov_scan(double a, double b, double c, char *names)
+{
+  double lo = HUGE_VAL, hi = -HUGE_VAL, l, v[3];
+  int i, j, val;
+
+  scanvals[0] = a; scanvals[1] = b; scanvals[2] = c;
+  scanvals[3] = xx0; scanvals[4] = yy0; scanvals[5] = zz0;
+  scanix = scanx ? lyapunov_index(scanx, names) : 0;
+  scaniy = scany ? lyapunov_index(scany, names) :
+    (strchr(names, ' ') ? 1 : 3);
+
+  /* Ranges that are left at zero go from half to one and a half times
+   * the value.
+   */
+  if(sxmin == 0 && sxmax == 0) {
+    sxmin = 0.5 * scanvals[scanix]; sxmax = 1.5 * scanvals[scanix];
+  }
+  if(symin == 0 && symax == 0) {
+    symin = 0.5 * scanvals[scaniy]; symax = 1.5 * scanvals[scaniy];
+  }
+
+  lyap = xmalloc(sizeof(double) * width * height);
+  parallel_tasks(height, threads, lyapunov_row, NULL);
+
+  if(data) {
+    data_init(format, "x y lyapunov");
+    for(j = 0; j < height; j++)
+      for(i = 0; i < width; i++) {
+        v[0] = sxmin + (sxmax - sxmin) * i / MAX(width - 1, 1);
+        v[1] = symax - (symax - symin) * j / MAX(height - 1, 1);
+        v[2] = lyap[j * width + i];
+        data_write(v);
+      }
+    data_finish();
+    free(lyap);
+    return;
+  }
+
+  if(lmin == 0 && lmax == 0) {
+    for(i = 0; i < width * height; i++)
+      if(lyap[i] != HUGE_VAL) {
+        lo = MIN(lo, lyap[i]); hi = MAX(hi, lyap[i]);
+      }
+    lmin = lo; lmax = (hi > lo) ? hi : lo + 1;
+  }
+
+  plot_mag = mag;
+  plot_inverse = invert;
+  plot_init(width, height, levels, term);
+  plot_set_range(0, width - 1, height - 1, 0);
+  for(j = 0; j < height; j++)
+    for(i = 0; i < width; i++) {
+      l = lyap[j * width + i];
+      if(l == HUGE_VAL) val = 0;
+      else {
+        val = (l - lmin) / (lmax - lmin) * (levels - 1) + 0.5;
+        val = MAX(0, MIN(levels - 1, val));
+      }
+      plot_point(i, j, val);
+    }
+  plot_finish();
+  free(lyap);
+}
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
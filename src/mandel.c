@@ -5,6 +5,33 @@
  *   The autoscaling features of the plot library are not used because
  *   there is a slim chance of round-off problems resulting in a
  *   skipped line.
+ *
+ *   With -prog, the image is first computed on a coarse grid with
+ *   PSTEP pixels between samples, with each sample filling its
+ *   block, and the grid is then halved until every pixel is
+ *   computed.  Samples from coarser passes are reused, so the total
+ *   work is the same as a normal render.  The plot is updated after
+ *   each pass; with the pgm terminal each pass is written as a
+ *   separate image, so stdout becomes a stream of pgm files.
+ *
+ *   A positive -frames value renders a zoom sequence that moves from
+ *   the view given by -ulx, -uly, and -lly to the view given by
+ *   -eulx, -euly, and -elly.  The height of the view changes
+ *   geometrically from frame to frame.  Instead of computing each
+ *   frame from scratch, keyframes are computed with SS times the
+ *   resolution of the plot and the frames that follow are resampled
+ *   from them.  A new keyframe is computed only when the samples of
+ *   the old one become coarser than the pixels of the current frame,
+ *   and pixels that fall outside of the keyframe are computed
+ *   directly.  The frames are emitted as with -prog, and no box is
+ *   drawn.
+ *
+ *   The -precision option selects the arithmetic of the iteration:
+ *   float is fastest, double is the default, and dd (double-double)
+ *   is about twice as precise as double but several times slower.
+ *   With auto, the cheapest type whose round-off is safely below
+ *   the pixel spacing is used, which is float for wide views and dd
+ *   for deep zooms.
  * COLORS
  *   The four permutations of using or not using -rev and -inv will
  *   yield four different coloring schemes.  Try it and see.
@@ -39,7 +66,9 @@
 int width = 640, height = 480, maxit = 160, invert = 0;
 int levels = 256, rev = 0, box = 0, idiv = 1, mag = 1;
 double ulx = -2.4, uly = 1.4, lly = -1.4, bulx, buly, blly, bail = 16.0;
-char *term = NULL;
+int prog = 0, pstep = 16, frames = 0, ss = 2;
+double eulx = -2.4, euly = 1.4, elly = -1.4;
+char *term = NULL, *precision = "double";
 
 char help_string[] = "\
 The Mandelbrot set is drawn according to the specified parameters.  The  \
@@ -75,59 +104,271 @@ OPTION options[] = {
   { "-rev",    OPT_SWITCH,  &rev,    "Reverse all colors but first?" },
   { "-inv",    OPT_SWITCH,  &invert, "Invert all colors?" },
   { "-mag",    OPT_INT,     &mag,    "Magnification factor." },
+  { "-prog",   OPT_SWITCH,  &prog,   "Render progressively?" },
+  { "-pstep",  OPT_INT,     &pstep,
+    "Initial pixel step of a progressive render." },
+  { "-frames", OPT_INT,     &frames,
+    "Number of frames in a zoom sequence.  If zero, draw one image." },
+  { "-eulx",   OPT_DOUBLE,  &eulx,
+    "Upper-left corner x-coordinate of the last frame." },
+  { "-euly",   OPT_DOUBLE,  &euly,
+    "Upper-left corner y-coordinate of the last frame." },
+  { "-elly",   OPT_DOUBLE,  &elly,
+    "Lower-left corner y-coordinate of the last frame." },
+  { "-ss",     OPT_INT,     &ss,
+    "Supersampling factor of zoom sequence keyframes." },
+  { "-precision", OPT_STRING, &precision,
+    "Arithmetic to use: one of float, double, dd, or auto." },
   { "-term",   OPT_STRING,  &term,   "How to plot points." },
   { NULL,      OPT_NULL,    NULL,    NULL }
 };
 
 /* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
 
+/* The escape-time kernels, where c is the pixel and z(0) = c.  The
+   step is the complex equation, which sets the updates to z = (za, zb). */
+
+#include "precision.c"
+
+#define ESCAPE_INIT(P, l) \
+  ca[l] = za[l]; \
+  cb[l] = zb[l]
+
+#define ESCAPE_STEP(P, l) \
+  u[l] = P ## _sqr(za[l]); \
+  v[l] = P ## _sqr(zb[l]); \
+  zb[l] = P ## _add(P ## _twice(P ## _mul(za[l], zb[l])), cb[l]); \
+  za[l] = P ## _add(P ## _sub(u[l], v[l]), ca[l])
+
+ESCAPE_KERNEL(escape_flt, float, flt, 16)
+ESCAPE_KERNEL(escape_dbl, double, dbl, 8)
+ESCAPE_KERNEL(escape_dd, DD, dd, 1)
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+/* Returns the kernel for the requested precision, given a view with
+   upper-left corner (ox, oy), pixel size inc, and size w x h. */
+
+static ESCAPEFUNC escape_kernel(double ox, double oy, double inc,
+                                int w, int h)
+{
+  double scale;
+
+  scale = MAX(MAX(fabs(ox), fabs(ox + (w - 1) * inc)),
+              MAX(fabs(oy), fabs(oy - (h - 1) * inc)));
+  scale = MAX(scale, sqrt(bail));
+  switch(get_precision(precision, inc, scale)) {
+    case PREC_FLOAT:
+      return(escape_flt);
+    case PREC_DD:
+      return(escape_dd);
+    default:
+      return(escape_dbl);
+  }
+}
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+/* Maps an escape time to a gray level. */
+
+static int color(int k)
+{
+  if(k == 0)
+    return(0);
+  if(rev)
+    return(-((k / idiv + (k % idiv) * (levels / idiv)) % levels) +
+           levels - 1);
+  else
+    return((k / idiv + (k % idiv) * (levels / idiv)) % levels);
+}
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+/* Fill the STEP x STEP block with the upper-left corner at (i, j),
+   clipped to the plot. */
+
+static void fill_block(int i, int j, int step, int val)
+{
+  int jj, last;
+
+  last = MIN(i + step, width) - 1;
+  for(jj = j; jj < j + step && jj < height; jj++)
+    if(last == i)
+      plot_point(i, jj, val);
+    else
+      plot_line(i, jj, last, jj, val);
+}
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+/* Render in passes of decreasing step size.  A pixel that lies on
+   the grid of the previous pass was computed there and its block
+   already has the right color in the upper-left quadrant, so only
+   the three new samples per old block are computed. */
+
+static void render_progressive(ESCAPEFUNC escape, double inc)
+{
+  int i, j, n, step, top, first, stride, *row;
+
+  row = xmalloc(sizeof(int) * width);
+  for(top = 1; top * 2 <= pstep; top *= 2) ;
+  for(step = top; step >= 1; step /= 2) {
+    for(j = 0; j < height; j += step) {
+      if(step < top && j % (2 * step) == 0)
+        first = step, stride = 2 * step;
+      else
+        first = 0, stride = step;
+      if((n = (width - first + stride - 1) / stride) <= 0)
+        continue;
+      escape(ulx, uly, inc, 0.0, 0.0, first, stride, j, n, row);
+      for(i = 0; i < n; i++)
+        fill_block(first + i * stride, j, step, color(row[i]));
+    }
+    if(step > 1)
+      plot_frame();
+  }
+  free(row);
+}
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+/* Compute the view of frame f of a zoom sequence.  The height of the
+   view changes geometrically, and the corner moves in proportion to
+   the change in height so that the zoom has a fixed center. */
+
+static void sequence_view(int f, double *fulx, double *fuly, double *finc)
+{
+  double h0, h1, h, s, t;
+
+  h0 = uly - lly;
+  h1 = euly - elly;
+  t = (frames > 1) ? (double) f / (frames - 1) : 0.0;
+  h = h0 * pow(h1 / h0, t);
+  s = (h0 == h1) ? t : (h0 - h) / (h0 - h1);
+  *fulx = ulx + s * (eulx - ulx);
+  *fuly = uly + s * (euly - uly);
+  *finc = h / (height - 1);
+}
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+/* Render a zoom sequence by resampling supersampled keyframes.  Each
+   pixel takes the escape time of the nearest keyframe sample, so a
+   keyframe is good until the pixel spacing drops below the keyframe's
+   sample spacing.  Pixels outside of the keyframe are computed
+   directly, and if more than half of a frame had to be computed that
+   way (as when zooming out) the next frame becomes a keyframe. */
+
+static void render_sequence(void)
+{
+  int f, i, j, ki, kj, kw, kh, *key, *row, *out, missed, rekey, first;
+  double fulx, fuly, finc, kulx = 0, kuly = 0, kinc = 0, x, y;
+  ESCAPEFUNC escape;
+
+  if(ss < 1) ss = 1;
+  kw = width * ss;
+  kh = height * ss;
+  key = xmalloc(sizeof(int) * kw * kh);
+  row = xmalloc(sizeof(int) * width);
+  out = xmalloc(sizeof(int) * width);
+  rekey = 1;
+  for(f = 0; f < frames; f++) {
+    sequence_view(f, &fulx, &fuly, &finc);
+
+    /* Make a new keyframe if the old one is too coarse. */
+    if(rekey || kinc > finc * (1.0 + 1e-9)) {
+      kulx = fulx;
+      kuly = fuly;
+      kinc = finc / ss;
+      escape = escape_kernel(kulx, kuly, kinc, kw, kh);
+      for(kj = 0; kj < kh; kj++)
+        escape(kulx, kuly, kinc, 0.0, 0.0, 0, 1, kj, kw, key + kj * kw);
+    }
+
+    /* Resample the keyframe into this frame. */
+    escape = escape_kernel(fulx, fuly, finc, width, height);
+    missed = 0;
+    for(j = 0; j < height; j++) {
+      y = fuly - j * finc;
+      for(i = 0; i < width; i++) {
+        x = fulx + i * finc;
+        ki = floor((x - kulx) / kinc + 0.5);
+        kj = floor((kuly - y) / kinc + 0.5);
+        out[i] = !(ki >= 0 && ki < kw && kj >= 0 && kj < kh);
+        if(!out[i])
+          row[i] = key[kj * kw + ki];
+      }
+
+      /* The keyframe is a rectangle, so the pixels of the row that
+       * fall outside of it come in at most two runs, and each run is
+       * computed with one call, which keeps the lanes of the kernel
+       * busy.
+       */
+      for(i = 0; i < width; i++) {
+        if(!out[i])
+          continue;
+        for(first = i; i < width && out[i]; i++) ;
+        escape(fulx, fuly, finc, 0.0, 0.0, first, 1, j, i - first,
+               row + first);
+        missed += i - first;
+      }
+      for(i = 0; i < width; i++)
+        plot_point(i, j, color(row[i]));
+    }
+    rekey = missed > width * height / 2;
+    if(f < frames - 1)
+      plot_frame();
+  }
+  free(out);
+  free(row);
+  free(key);
+}
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
 int main(int argc, char **argv)
 {
   extern int plot_mag;
   extern int plot_inverse;
-  int i, j, k;
-  double inc, binc, a, b, u, v, w, x, y;
+  int i, j, *row;
+  double inc, binc;
+  ESCAPEFUNC escape;
 
   get_options(argc, argv, options, help_string);
 
+  /* Compute the size increment of a single pixel, and pick the kernel
+   * once for the whole image, which also checks -precision before
+   * anything is plotted.
+   */
+  inc = (uly - lly) / (height - 1);
+  escape = escape_kernel(ulx, uly, inc, width, height);
+
   plot_mag = mag;
   plot_inverse = invert;
   plot_init(width, height, levels, term);
   plot_set_all(0);
 
-  /* Compute the size increment of a single pixel. */
-  inc = (uly - lly) / (height - 1);
+  if(frames > 0) {
+    render_sequence();
+    plot_finish();
+    exit(0);
+  }
 
-  /* For each vertical line... */
-  for(j = 0, y = uly; j < height; j++, y -= inc) {
-
-    /* For each  horizontal line... */
-    for(i = 0, x = ulx; i < width; i++, x += inc) {
-      a = x;
-      b = y;
-
-      /* Inner loop for the point (x, y). */
-      for(k = 1; k <= maxit; k++) {
-
-        /* The complex equation, which sets the updates to (a, b). */
-        u = a * a;
-        v = b * b;
-        w = 2.0 * a * b;
-        a = u - v + x;
-        b = w + y;
-
-        /* Check bailout condition, and plot as appropriate. */
-        if(u + v > bail) {
-          if(rev)
-            plot_point(i, j, -((k / idiv + (k % idiv) * (levels / idiv)) %
-                               levels) + levels - 1);
-          else
-            plot_point(i, j, (k / idiv + (k % idiv) *
-                              (levels / idiv)) % levels);
-          break;
-        }
-      }
-    } 
+  if(prog)
+    render_progressive(escape, inc);
+  else {
+    row = xmalloc(sizeof(int) * width);
+
+    /* For each vertical line... */
+    for(j = 0; j < height; j++) {
+
+      /* Compute the whole horizontal line and plot the diverging points. */
+      escape(ulx, uly, inc, 0.0, 0.0, 0, 1, j, width, row);
+      for(i = 0; i < width; i++)
+        if(row[i] != 0)
+          plot_point(i, j, color(row[i]));
+    }
+    free(row);
   }
 
   /* Show a box, if appropriate. */
@@ -5,78 +5,130 @@
  *   The functions in this file are one-dimensional maps.  This file
  *   is written in such a way that it should be included in the other
  *   programs that need the maps, and not compiled directly.
- *   
- *   The function get_named_function() expects that all functions
- *   that it may return reside in this file.
+ *
+ *   Every map is written once, as a macro of x and r such as MAP_LOG(),
+ *   and listed with its name in the table MAPS1D.  Everything else is
+ *   made from the table: the functions fsin(), ftent(), flog(), and
+ *   fgauss(), which get_named_function() returns, and the loops below
+ *   that are expanded once for every map, with the map inlined,
+ *   instead of calling it through a pointer on every iteration.  A
+ *   program can do the same with a loop of its own by defining
+ *   MAP1D_LOOP(F) as the loop, with F(x, r) standing for the map, and
+ *   using MAP1D_DISPATCH() with the number of the map, as returned by
+ *   get_named_map().  The switch is then done once per loop.
  * AUTHOR
  *   Copyright (c) 1997, Gary William Flake.
- *   
+ *
  *   Permission granted for any use according to the standard GNU
  *   ``copyleft'' agreement provided that the author's comments are
  *   neither modified nor removed.  No warranty is given or implied.
  */
 
+/* The maps as expressions.  The arguments are evaluated more than
+   once, so they should be plain variables. */
+
+#define MAP_SIN(x, r)   (sin((x) * M_PI * aux * 2.0 * (r)) * 0.5 + 0.5)
+#define MAP_TENT(x, r)  (2.0 * (r) * MIN((x), 1.0 - (x)))
+#define MAP_LOG(x, r)   (4.0 * (r) * (x) * (1.0 - (x)))
+#define MAP_GAUSS(x, r) ((r) * exp(-aux * ((x) - 0.5) * ((x) - 0.5)))
+
+/* Add a new map here, e.g.
+
+#define MAP_YOURS(x, r) (????)
+
+   and add a line for it to the table, e.g.
+
+  M(yours, MAP_YOURS) \
+
+   which makes a function fyours() and the name "yours" for -func. */
+
+/* The table of maps, as M(name, expression) for each of them.  The
+   first entry is also used for names that are not in the table. */
+
+#define MAPS1D(M) \
+  M(log,   MAP_LOG) \
+  M(sin,   MAP_SIN) \
+  M(tent,  MAP_TENT) \
+  M(gauss, MAP_GAUSS)
+
+#define MAP1D_ENUM(name, F) MAP1D_##name,
+#define MAP1D_NAME(name, F) #name,
+#define MAP1D_FUNC(name, F) f##name,
+#define MAP1D_CASE(name, F) case MAP1D_##name: MAP1D_LOOP(F); break;
+#define MAP1D_DEFINE(name, F) \
+  double f##name(double x, double r) { return(F(x, r)); }
+
+enum { MAPS1D(MAP1D_ENUM) MAP1D_COUNT };
+
+MAPS1D(MAP1D_DEFINE)
+
+static char *map1d_names[] = { MAPS1D(MAP1D_NAME) NULL };
+static double (*map1d_funcs[])(double x, double r) = { MAPS1D(MAP1D_FUNC) };
+
+/* Run MAP1D_LOOP() with map number I inlined. */
+
+#define MAP1D_DISPATCH(i) \
+  do { switch(i) { MAPS1D(MAP1D_CASE) } } while(0)
+
 /* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
 
-double fsin(double x, double r)
+/* The number of the map named NAME in MAPS1D, or of the first map if
+   there is none. */
+
+int get_named_map(char *name)
 {
-  return(sin(x * M_PI * aux * 2.0 * r) * 0.5 + 0.5);
+  int i;
+
+  for(i = 0; i < MAP1D_COUNT; i++)
+    if(!strcmp(name, map1d_names[i]))
+      return(i);
+  return(0);
 }
 
 /* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
 
-double ftent(double x, double r)
+double (*get_named_function(char *name))(double x, double r)
 {
-  return((x <= 0.5) ? 2.0 * r * x : 2 * r * (1.0 - x));
+  return(map1d_funcs[get_named_map(name)]);
 }
 
 /* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
 
-double flog(double x, double r)
+/* Fill ORBIT with the N iterates of map number MAP that follow X, and
+   return the last, or X if N is zero. */
+
+double map1d_orbit(int map, double x, double r, int n, double *orbit)
 {
-  return(4.0 * r * x * (1.0 - x));
-}
+  int i;
 
+#define MAP1D_LOOP(F) \
+  for(i = 0; i < n; i++) { \
+    x = F(x, r); \
+    orbit[i] = x; \
+  }
 
-/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+  MAP1D_DISPATCH(map);
 
-double fgauss(double x, double r)
-{
-  return(r * exp(-aux * (x - 0.5) * (x - 0.5)));
+#undef MAP1D_LOOP
+  return(x);
 }
 
 /* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
 
-/* Add a new map function here, e.g.
+/* Return the result of iterating map number MAP N times from X. */
 
-double your_function(double x, double r)
+double map1d_iterate(int map, double x, double r, int n)
 {
-  return(????);
-}
+  int i;
 
-*/
+#define MAP1D_LOOP(F) \
+  for(i = 0; i < n; i++) \
+    x = F(x, r)
 
-/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+  MAP1D_DISPATCH(map);
 
-double (*get_named_function(char *name))(double x, double r)
-{
-  if(!strcmp(func, "sin"))
-    return(fsin);
-  else if(!strcmp(func, "tent"))
-    return(ftent);
-  else if(!strcmp(func, "log"))
-    return(flog);
-  else if(!strcmp(func, "gauss"))
-    return(fgauss);
-
-  /* Add a new function name here, e.g.
-
-  else if(!strcmp(func, "your_function_name")
-    return(your_function);
-   
-   */
-  
-  return(flog);
+#undef MAP1D_LOOP
+  return(x);
 }
 
 /* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
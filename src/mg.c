@@ -12,6 +12,27 @@
  *   The program uses a second-order Euler's method to perform the
  *   numerical integration, which is sufficient for simple tasks such
  *   as this.
+ *
+ *   With -data, the -format option can be used to write the points as
+ *   binary floats instead of text, and -stride to keep only every
+ *   STRIDE-th point.
+ *
+ *   The usual solver rounds Tau to a whole number of time steps.  With
+ *   -dde, a solver for delay differential equations is used instead,
+ *   which takes the delayed value from cubic Hermite interpolation
+ *   between the two stored steps around it, using the stored
+ *   derivatives as well as the values, so Tau can be any value of at
+ *   least DT.  The history is kept in a ring buffer whose size is a
+ *   power of two, so indexing it only takes a mask, and since the
+ *   delay is fixed, the interpolation weights are computed once.  The
+ *   history before time zero is constant at X0.
+ *
+ *   With -ntau N, an ensemble of N systems with values of Tau evenly
+ *   spaced from TAU to TAUMAX is integrated with the -dde solver, with
+ *   the systems divided among THREADS threads (or all processors if
+ *   THREADS is zero).  With -data, each line then has x(t) for every
+ *   system; otherwise the plots of all of the systems are drawn on top
+ *   of each other.
  * BUGS
  *   No sanity checks are performed to make sure that any of the
  *   options make sense.
@@ -29,9 +50,11 @@
 #include "misc.h"
 
 int width = 480, height = 480, skip = 2000, points = 10000;
-int delta = 6, data = 0, invert = 0, mag = 1, tau = 17;
+int delta = 6, data = 0, invert = 0, mag = 1, stride = 1;
+int dde = 0, ntau = 0, threads = 1;
 double a = 0.2, b = 0.1, dt = 0.1, factor = 0.2, xx0 = 1.23456789;
-char *term = NULL;
+double tau = 17, taumax = 30;
+char *term = NULL, *format = "text";
 
 char help_string[] = "\
 The phase space of the Mackey-Glass system, which is described by the \
@@ -50,13 +73,20 @@ OPTION options[] = {
   { "-skip",   OPT_INT,     &skip,   "Number of initial points to skip." },
   { "-points", OPT_INT,     &points, "Number of points to plot." },
   { "-delta",  OPT_INT,     &delta,  "Time steps to delay for." },
-  { "-tau",    OPT_INT,     &tau,    "Value of the Tau parameter." },
+  { "-tau",    OPT_DOUBLE,  &tau,    "Value of the Tau parameter." },
   { "-A",      OPT_DOUBLE,  &a,      "Value of the A parameter." },
   { "-B",      OPT_DOUBLE,  &b,      "Value of the B parameter." },
   { "-dt",     OPT_DOUBLE,  &dt,     "Time step size." },
   { "-x0",     OPT_DOUBLE,  &xx0,    "Initial X value." },
+  { "-dde",    OPT_SWITCH,  &dde,    "Interpolate delays with any Tau?" },
+  { "-ntau",   OPT_INT,     &ntau,   "Number of Tau values to run." },
+  { "-taumax", OPT_DOUBLE,  &taumax, "Largest Tau value with -ntau." },
+  { "-threads", OPT_INT,    &threads,
+    "Number of threads for -ntau.  If zero, use all processors." },
   { "-factor", OPT_DOUBLE,  &factor, "Auto-scale expansion factor." },
   { "-data",   OPT_SWITCH,  &data,   "Don't plot, but print points." },
+  { "-format", OPT_STRING,  &format, "text, csv, f32, f64, or bin." },
+  { "-stride", OPT_INT,     &stride, "Print every STRIDE-th point." },
   { "-inv",    OPT_SWITCH,  &invert, "Invert all colors?" },
   { "-mag",    OPT_INT,     &mag,    "Magnification factor." },
   { "-term",   OPT_STRING,  &term,   "How to plot points." },
@@ -65,102 +95,302 @@ OPTION options[] = {
 
 /* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
 
+/* The right hand side of the MG system, with x^10 done with four
+   multiplies instead of a call to pow(). */
+
+static double mgfunc(double xt, double xtau, double a, double b)
+{
+  double x2, x8;
+
+  x2 = xtau * xtau;
+  x8 = x2 * x2; x8 *= x8;
+  return((a * xtau) / (1 + x8 * x2) - b * xt);
+}
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
 /* Perform a second-order Euler step according to the MG system equation. */
 
 double euler(double xt, double xtau, double a, double b, double dt)
 {
   double x1, x2;
 
-  x1 = (a * xtau) / (1 + pow(xtau, 10.0)) - b * xt;
-  x2 = (a * xtau) / (1 + pow(xtau, 10.0)) - b * (dt * x1 + xt);
+  x1 = mgfunc(xt, xtau, a, b);
+  x2 = mgfunc(dt * x1 + xt, xtau, a, b);
   return(xt + 0.5 * dt * (x1 + x2));
 }
 
 /* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
 
+/* The state of the -dde solver.  X and DX hold the values and
+   derivatives of the last MASK + 1 steps, with step N in entry
+   N & MASK.  The delayed value for step N comes from steps N - OFF
+   and N - OFF + 1, weighted by W. */
+
+typedef struct DDE {
+  double *x, *dx, w[4];
+  int mask, n, off;
+} DDE;
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+/* Start a system with a delay of TAU, keeping at least KEEP steps. */
+
+void dde_init(DDE *d, double tau, int keep)
+{
+  double s = tau / dt, u, u2, u3;
+  int i, size;
+
+  if(s < 1) {
+    fprintf(stderr, "Tau (%g) must be at least one time step.\n", tau);
+    exit(1);
+  }
+
+  /* The delayed point is U of the way from step N - OFF to the next.
+   * The derivative terms are scaled by DT, since the steps are one
+   * unit apart.
+   */
+  d->off = ceil(s);
+  u = d->off - s; u2 = u * u; u3 = u2 * u;
+  d->w[0] = 2 * u3 - 3 * u2 + 1;
+  d->w[1] = (u3 - 2 * u2 + u) * dt;
+  d->w[2] = -2 * u3 + 3 * u2;
+  d->w[3] = (u3 - u2) * dt;
+
+  for(size = 4; size < d->off + 2 || size < keep; size *= 2) ;
+  d->mask = size - 1;
+  d->x = xmalloc(sizeof(double) * size);
+  d->dx = xmalloc(sizeof(double) * size);
+  for(i = 0; i < size; i++) {
+    d->x[i] = xx0;
+    d->dx[i] = 0;
+  }
+  d->n = 0;
+  d->dx[0] = mgfunc(xx0, xx0, a, b);
+}
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+/* Take one second-order Euler step.  The first stage is the
+   derivative that was saved at the end of the last step, and the
+   second uses the delayed value for the end of this step. */
+
+void dde_step(DDE *d)
+{
+  int i, j, k0, k1;
+  double xt, xtau, x1, x2;
+
+  i = d->n & d->mask;
+  j = (d->n + 1) & d->mask;
+  k0 = (d->n + 1 - d->off) & d->mask;
+  k1 = (d->n + 2 - d->off) & d->mask;
+  xtau = d->w[0] * d->x[k0] + d->w[1] * d->dx[k0] +
+    d->w[2] * d->x[k1] + d->w[3] * d->dx[k1];
+  xt = d->x[i];
+  x1 = d->dx[i];
+  x2 = mgfunc(dt * x1 + xt, xtau, a, b);
+  d->x[j] = xt + 0.5 * dt * (x1 + x2);
+  d->dx[j] = mgfunc(d->x[j], xtau, a, b);
+  d->n++;
+}
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+/* The value of the system K steps ago. */
+
+double dde_past(DDE *d, int k)
+{
+  return(d->x[(d->n - k) & d->mask]);
+}
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+/* The plot range, and whether it has been set. */
+
+double xmin = 10e10, xmax = -10e10, ymin = 10e10, ymax = -10e10;
+int ranged = 0;
+
+/* Do whatever should be done with (X, Y) as the I-th point of a
+   system, where LAST holds the previous point of that system. */
+
+void show(int i, double x, double y, double *last)
+{
+  double temp, v[2];
+
+  if(data) {
+    if(i >= skip + delta + 1 && (i - skip - delta - 1) % stride == 0) {
+      v[0] = x; v[1] = y;
+      data_write(v);
+    }
+    return;
+  }
+
+  /* If we are still skipping points, adjust the best guesses for
+   * the minimum and maximums.
+   */
+  if(i < skip + delta + 1) {
+    xmin = (x < xmin) ? x : xmin; xmax = (x > xmax) ? x : xmax;
+    ymin = (y < ymin) ? y : ymin; ymax = (y > ymax) ? y : ymax;
+  }
+
+  /* If this is the last point to be skipped, reset the plotting
+   * range based on the minimum and maximums.
+   */
+  if(i == skip + delta + 1 && !ranged) {
+    ranged = 1;
+    temp = (xmax - xmin) * factor; xmin -= temp; xmax += temp;
+    temp = (ymax - ymin) * factor; ymin -= temp; ymax += temp;
+    plot_set_range(xmin, xmax, ymin, ymax);
+  }
+
+  /* Plot a line from the last point to the current point. */
+  if(i >= skip + delta + 1)
+    plot_line(last[0], last[1], x, y, 1);
+
+  /* Save the last point. */
+  last[0] = x; last[1] = y;
+}
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+/* The members of an ensemble, and the values of each of them over a
+   block of EBLOCK steps. */
+
+#define EBLOCK 4096
+
+static DDE *ensdde;
+static double **ensx, **ensy;
+static int ensn, enstdelta;
+
+static void ensemble_task(int m, void *arg)
+{
+  int j;
+
+  for(j = 0; j < ensn; j++) {
+    dde_step(&ensdde[m]);
+    ensx[m][j] = dde_past(&ensdde[m], 0);
+    ensy[m][j] = dde_past(&ensdde[m], enstdelta);
+  }
+}
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+/* Integrate NTAU systems for TOTAL steps each.  The systems are run a
+   block at a time in parallel, and then the block is shown a step at
+   a time, so that the order of the output does not depend on the
+   threads. */
+
+void ensemble(int total, int tdelta)
+{
+  double *last, *v, t;
+  char *names;
+  int i, j, m;
+
+  ensdde = xmalloc(sizeof(DDE) * ntau);
+  ensx = xmalloc(sizeof(double *) * ntau);
+  ensy = xmalloc(sizeof(double *) * ntau);
+  last = xmalloc(sizeof(double) * 2 * ntau);
+  v = xmalloc(sizeof(double) * ntau);
+  names = xmalloc(32 * ntau + 1);
+  names[0] = 0;
+  for(m = 0; m < ntau; m++) {
+    t = (ntau > 1) ? tau + (taumax - tau) * m / (ntau - 1) : tau;
+    dde_init(&ensdde[m], t, tdelta + 1);
+    ensx[m] = xmalloc(sizeof(double) * EBLOCK);
+    ensy[m] = xmalloc(sizeof(double) * EBLOCK);
+    last[2 * m] = last[2 * m + 1] = 0;
+    sprintf(names + strlen(names), "%sx_tau%g", m ? " " : "", t);
+  }
+  if(data) data_init(format, names);
+  enstdelta = tdelta;
+
+  for(i = 0; i < total; i += ensn) {
+    ensn = MIN(EBLOCK, total - i);
+    parallel_tasks(ntau, threads, ensemble_task, NULL);
+    for(j = 0; j < ensn; j++) {
+      if(data) {
+        if(i + j < skip + delta + 1 ||
+           (i + j - skip - delta - 1) % stride != 0) continue;
+        for(m = 0; m < ntau; m++)
+          v[m] = ensx[m][j];
+        data_write(v);
+      }
+      else
+        for(m = 0; m < ntau; m++)
+          show(i + j, ensx[m][j], ensy[m][j], last + 2 * m);
+    }
+  }
+}
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
 int main(int argc, char **argv)
 {
   extern int plot_mag;
   extern int plot_inverse;
   int i, hsz, h, ttau, tdelta;
-  /* Variables used to compute auto-scaling. */
-  double xmin, xmax, ymin, ymax;
-  double x, y, xx = 0, yy = 0, xt, xtau, temp, *hold;
+  double x, y, xt, xtau, *hold, last[2];
+  DDE d;
 
   get_options(argc, argv, options, help_string);
+  if(stride < 1) stride = 1;
 
-  if(!data) {
-    plot_mag = mag;
-    plot_inverse = invert;
-    plot_init(width, height, 2, term);
-    plot_set_all(0);
+  if(!data || ntau <= 0) {
+    if(data)
+      data_init(format, "x x_delta");
+    else {
+      plot_mag = mag;
+      plot_inverse = invert;
+      plot_init(width, height, 2, term);
+      plot_set_all(0);
+    }
   }
 
   /* Recalculate Tau and delta to reflect time step size. */
   ttau = 1 / dt * tau + 0.5;
   tdelta = 1 / dt * delta + 0.5;
 
-  /* Initialize the buffer space. */
-  hsz = MAX(tdelta + 1, ttau + 1);
-  hold = xmalloc(hsz * sizeof(double));
-
-  /* Initialize the system. */
-  h = 0;
-  for(i = 0; i < hsz; i++)
-    hold[i] = xx0;
-  
-  /* Set insane minimum and maximum guesses. */
-  xmin = ymin = 10e10;
-  xmax = ymax = -10e10;
-
-  /* For all points (plus the skip and delay values. */
-  for(i = 0; i < points + skip + tdelta + 1; i++) {
-
-    /* Compute the time evolution of the system. */
-    xtau = hold[(h + hsz - (ttau + 1)) % hsz];
-    xt = hold[(h + hsz - 1) % hsz];
-    x = euler(xt, xtau, a, b, dt);
-
-    /* Save the state so that we can remember delayed values. */
-    hold[h] = x; h++; h %= hsz;
+  if(ntau > 0)
+    ensemble(points + skip + tdelta + 1, tdelta);
+  else if(dde) {
+    dde_init(&d, tau, tdelta + 1);
+    last[0] = last[1] = 0;
+    for(i = 0; i < points + skip + tdelta + 1; i++) {
+      dde_step(&d);
+      show(i, dde_past(&d, 0), dde_past(&d, tdelta), last);
+    }
+  }
+  else {
+    /* Initialize the buffer space. */
+    hsz = MAX(tdelta + 1, ttau + 1);
+    hold = xmalloc(hsz * sizeof(double));
 
-    /* Get the delayed value. */
-    y = hold[(h + hsz - tdelta) % hsz];
+    /* Initialize the system. */
+    h = 0;
+    for(i = 0; i < hsz; i++)
+      hold[i] = xx0;
+    last[0] = last[1] = 0;
 
-    if(data) {
-      if(i >= skip + delta + 1)
-        printf("%f\t%f\n", x, y);
-    }
-    else {
-      /* If we are still skipping points, adjust the best guesses for
-       * the minimum and maximums.
-       */
-      if(i < skip + delta + 1) {
-        xmin = (x < xmin) ? x : xmin; xmax = (x > xmax) ? x : xmax;
-        ymin = (y < ymin) ? y : ymin; ymax = (y > ymax) ? y : ymax;
-      }
+    /* For all points (plus the skip and delay values. */
+    for(i = 0; i < points + skip + tdelta + 1; i++) {
 
-      /* If this is the last point to be skipped, reset the plotting
-       * range based on the minimum and maximums.
-       */
-      if(i == skip + delta + 1) {
-        temp = (xmax - xmin) * factor; xmin -= temp; xmax += temp;
-        temp = (ymax - ymin) * factor; ymin -= temp; ymax += temp;
-        plot_set_range(xmin, xmax, ymin, ymax);
-      }
+      /* Compute the time evolution of the system. */
+      xtau = hold[(h + hsz - (ttau + 1)) % hsz];
+      xt = hold[(h + hsz - 1) % hsz];
+      x = euler(xt, xtau, a, b, dt);
 
-      /* Plot a line from the last point to the current point. */
-      if(i >= skip + delta + 1)
-        plot_line(xx, yy, x, y, 1);
+      /* Save the state so that we can remember delayed values. */
+      hold[h] = x; h++; h %= hsz;
 
-      /* Save the last point. */
-      xx = x; yy = y;
+      /* Get the delayed value. */
+      y = hold[(h + hsz - tdelta) % hsz];
+      show(i, x, y, last);
     }
   }
 
-  if(!data) plot_finish();
+  if(data) data_finish();
+  else plot_finish();
   exit(0);
 }
 
 /* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
-
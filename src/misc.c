@@ -16,6 +16,11 @@
 #include <stdio.h>
 #include "misc.h"
 
+#ifdef PTHREADS
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
 /* A little buffer for formatting option help string entries. */
 
 #define BUFFERLEN 4096
@@ -369,6 +374,45 @@ double random_gauss(void)
 
 /* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
 
+#define RS32(x) ((x) & 0xffffffffUL)
+
+/* The state is filled from the seed and stream number with a simple
+   integer hash, so that nearby streams do not start out correlated. */
+
+void random_stream_init(RANDSTREAM *rs, unsigned long seed, int stream)
+{
+  unsigned long h, *s[4];
+  int i;
+
+  s[0] = &rs->x; s[1] = &rs->y; s[2] = &rs->z; s[3] = &rs->w;
+  h = RS32(seed * 2654435761UL + (unsigned long) stream * 40503UL + 1);
+  for(i = 0; i < 4; i++) {
+    h = RS32(h + 0x9e3779b9UL);
+    h = RS32((h ^ (h >> 16)) * 0x85ebca6bUL);
+    h = RS32((h ^ (h >> 13)) * 0xc2b2ae35UL);
+    h = RS32(h ^ (h >> 16));
+    *s[i] = h;
+  }
+  if((rs->x | rs->y | rs->z | rs->w) == 0)
+    rs->w = 1;
+}
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+double random_stream_range(RANDSTREAM *rs, double low, double high)
+{
+  unsigned long t;
+
+  t = RS32(rs->x ^ (rs->x << 11));
+  rs->x = rs->y;
+  rs->y = rs->z;
+  rs->z = rs->w;
+  rs->w = RS32(rs->w ^ (rs->w >> 19) ^ t ^ (t >> 8));
+  return(rs->w / 4294967296.0 * (high - low) + low);
+}
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
 int **read_pbm_file(char *fname, int *w, int *h)
 {
   int **data, i, j;
@@ -408,5 +452,253 @@ int **read_pbm_file(char *fname, int *w, int *h)
 
 /* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
 
+#ifdef PTHREADS
+
+/* Shared state for the threads of parallel_tasks().  Each thread
+   takes the next task number under the lock until none are left, so
+   tasks of uneven cost are balanced automatically. */
+
+typedef struct PARALLEL {
+  int next, ntasks;
+  void (*fn)(int task, void *arg);
+  void *arg;
+  pthread_mutex_t lock;
+} PARALLEL;
+
+static void *parallel_worker(void *ptr)
+{
+  PARALLEL *par = ptr;
+  int task;
+
+  while(1) {
+    pthread_mutex_lock(&par->lock);
+    task = par->next++;
+    pthread_mutex_unlock(&par->lock);
+    if(task >= par->ntasks) break;
+    par->fn(task, par->arg);
+  }
+  return(NULL);
+}
 
+#endif
 
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+int parallel_threads(int nthreads)
+{
+#ifdef PTHREADS
+  if(nthreads <= 0)
+    nthreads = sysconf(_SC_NPROCESSORS_ONLN);
+  return(MAX(nthreads, 1));
+#else
+  return(1);
+#endif
+}
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+void parallel_tasks(int ntasks, int nthreads,
+                    void (*fn)(int task, void *arg), void *arg)
+{
+  int i;
+#ifdef PTHREADS
+  PARALLEL par;
+  pthread_t *threads;
+
+  nthreads = MIN(parallel_threads(nthreads), ntasks);
+  if(nthreads > 1) {
+    par.next = 0;
+    par.ntasks = ntasks;
+    par.fn = fn;
+    par.arg = arg;
+    pthread_mutex_init(&par.lock, NULL);
+    threads = xmalloc(sizeof(pthread_t) * nthreads);
+    for(i = 0; i < nthreads; i++)
+      if(pthread_create(&threads[i], NULL, parallel_worker, &par) != 0) {
+        fprintf(stderr, "parallel_tasks: unable to create thread.\n");
+        exit(1);
+      }
+    for(i = 0; i < nthreads; i++)
+      pthread_join(threads[i], NULL);
+    pthread_mutex_destroy(&par.lock);
+    free(threads);
+    return;
+  }
+#endif
+  for(i = 0; i < ntasks; i++)
+    fn(i, arg);
+}
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+#ifdef PTHREADS
+static pthread_mutex_t parallel_mutex = PTHREAD_MUTEX_INITIALIZER;
+#endif
+
+void parallel_lock(void)
+{
+#ifdef PTHREADS
+  pthread_mutex_lock(&parallel_mutex);
+#endif
+}
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+void parallel_unlock(void)
+{
+#ifdef PTHREADS
+  pthread_mutex_unlock(&parallel_mutex);
+#endif
+}
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+/* Binary data is collected in a buffer of this many bytes, which is
+   written out whenever it fills up. */
+
+#define DATA_BLOCK (1 << 20)
+
+#define DATA_TEXT 0
+#define DATA_CSV  1
+#define DATA_F32  2
+#define DATA_F64  3
+
+static int data_format = DATA_TEXT, data_cols = 1, data_size = 0;
+static int data_used = 0, data_swap = 0;
+static unsigned char *data_buf = NULL;
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+void data_init(char *format, char *names)
+{
+  union { unsigned short s; unsigned char c[2]; } endian;
+  char *p;
+
+  if(!strcmp(format, "text")) data_format = DATA_TEXT;
+  else if(!strcmp(format, "csv")) data_format = DATA_CSV;
+  else if(!strcmp(format, "f32")) data_format = DATA_F32;
+  else if(!strcmp(format, "f64") || !strcmp(format, "bin"))
+    data_format = DATA_F64;
+  else {
+    fprintf(stderr, "Bad option passed to -format: \"%s\"\n", format);
+    exit(1);
+  }
+
+  for(p = names, data_cols = 1; *p; p++)
+    if(*p == ' ') data_cols++;
+
+  if(data_format == DATA_CSV) {
+    for(p = names; *p; p++)
+      putchar(*p == ' ' ? ',' : *p);
+    putchar('\n');
+  }
+  else if(data_format != DATA_TEXT) {
+    data_size = (data_format == DATA_F32) ? 4 : 8;
+    printf("CBNDATA %s %d %s\n", (data_size == 4) ? "f32" : "f64",
+           data_cols, names);
+    endian.s = 1;
+    data_swap = (endian.c[0] == 0);
+    data_buf = xmalloc(DATA_BLOCK);
+    data_used = 0;
+  }
+}
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+void data_write(double *v)
+{
+  unsigned char *b, t;
+  float f;
+  int i, j;
+
+  if(data_format == DATA_TEXT || data_format == DATA_CSV) {
+    for(i = 0; i < data_cols; i++)
+      if(data_format == DATA_TEXT)
+        printf(i ? "\t%f" : "%f", v[i]);
+      else
+        printf(i ? ",%.17g" : "%.17g", v[i]);
+    putchar('\n');
+    return;
+  }
+
+  if(data_used + data_cols * data_size > DATA_BLOCK) {
+    fwrite(data_buf, 1, data_used, stdout);
+    data_used = 0;
+  }
+  for(i = 0; i < data_cols; i++) {
+    b = data_buf + data_used;
+    if(data_size == 4) {
+      f = v[i];
+      memcpy(b, &f, 4);
+    }
+    else
+      memcpy(b, &v[i], 8);
+    if(data_swap)
+      for(j = 0; j < data_size / 2; j++) {
+        t = b[j]; b[j] = b[data_size - 1 - j]; b[data_size - 1 - j] = t;
+      }
+    data_used += data_size;
+  }
+}
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+void data_finish(void)
+{
+  if(data_buf) {
+    fwrite(data_buf, 1, data_used, stdout);
+    free(data_buf);
+    data_buf = NULL;
+  }
+  fflush(stdout);
+}
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+/* Brent's method for finding the period of a sequence: the value at a
+   checkpoint is compared with every new value, and the checkpoint is
+   moved up to the newest value whenever the distance to it reaches a
+   power of two.  Once the sequence has entered a cycle, it returns to
+   the checkpoint after exactly one period, so the first match gives
+   the period itself and not a multiple of it.  The powers stop growing
+   at the first one that is at least as large as the longest period
+   that is looked for.  Since a chaotic sequence can come back close
+   to the checkpoint by chance, a period is only returned once it has
+   been seen twice in a row. */
+
+void cycle_init(CYCLE *c, double tol, int maxper)
+{
+  c->tol = tol;
+  c->max = maxper;
+  c->power = 1;
+  c->dist = -1;
+  c->per = 0;
+}
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+int cycle_check(CYCLE *c, double x)
+{
+  if(c->dist >= 0) {
+    c->dist++;
+    if(c->per > 0) {
+      /* Confirming a period that was just seen. */
+      if(c->dist < c->per)
+        return(0);
+      if(fabs(x - c->x) < c->tol)
+        return(c->per);
+      c->per = 0;
+    }
+    else if(fabs(x - c->x) < c->tol && c->dist <= c->max)
+      c->per = c->dist;
+    else if(c->dist < c->power)
+      return(0);
+    else if(c->power < c->max)
+      c->power *= 2;
+  }
+  c->x = x;
+  c->dist = 0;
+  return(0);
+}
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
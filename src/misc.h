@@ -110,13 +110,83 @@ void     scan_flush(SCANNER *scanner);
 
 void plot_init(int width, int height, int levels, char *term);
 void plot_point(double x, double y, int val);
+void plot_pixels(int n, int *x, int *y, int val);
 void plot_set_range(double xmin, double xmax, double ymin, double ymax);
 void plot_set_all(int val);
 void plot_box(double ulx, double uly, double lrx, double lry, int lwidth);
 void plot_line(double x1, double y1, double x2, double y2, int val);
+void plot_lines(int n, double *seg, int val);
+void plot_count(unsigned int *count, double x, double y);
+void plot_counts(unsigned int *count, char *method);
+void plot_covers_init(int n);
+unsigned char *plot_cover_take(void);
+void plot_cover_give(unsigned char *cover);
+void plot_cover_lines(unsigned char *cover, int n, double *seg);
+void plot_covers_finish(int val);
 void plot_finish(void);
+void plot_frame(void);
 
-extern int plot_inverse, plot_mag;
+extern int plot_inverse, plot_mag, plot_super, plot_vector;
+
+/* The segment simplifier used by the vector plot drivers.  Points and
+   lines with the value BACKGROUND are not drawn. */
+
+void vecplot_init(void (*move)(int x, int y), void (*draw)(int x, int y),
+                  void (*dot)(int x, int y), int background);
+void vecplot_point(int x, int y, int val);
+void vecplot_line(int x1, int y1, int x2, int y2, int val);
+void vecplot_finish(void);
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+/* Routines for writing a series of samples to stdout, each with the
+   same number of values.  NAMES is a list of the names of the values,
+   separated by single spaces.  The format is one of "text" (values
+   separated by tabs), "csv" (a line of names and then full precision
+   values separated by commas), "f32" or "f64" (a line that starts
+   with CBNDATA and gives the type, the number of values, and the
+   names, followed by raw little-endian floats or doubles), or "bin",
+   which is the same as "f64".  data_finish() must be called at the
+   end. */
+
+void data_init(char *format, char *names);
+void data_write(double *v);
+void data_finish(void);
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+/* Routines for integrating ordinary differential equations, in ode.c... */
+
+#define ODE_MAXDIM 16
+
+/* The derivatives DY of a system at the state Y. */
+
+typedef void (*ODEFUNC)(double *y, double *dy);
+
+/* The state of an integration.  Y is the state at time T, and the
+   last step went from Y0 at T0, with size H0.  K0 and K hold the
+   stages of that step.  H is the size of the next step. */
+
+typedef struct ODE {
+  ODEFUNC f;
+  int n, method;
+  double t, t0, tout, h, h0, tol;
+  double y[ODE_MAXDIM], y0[ODE_MAXDIM], k0[ODE_MAXDIM];
+  double k[7][ODE_MAXDIM];
+  long nfev, nsteps;
+} ODE;
+
+/* Start integrating the N variables of F from Y at time zero, with the
+   method named METHOD ("euler", "rk4", "rk23", or "rk45"), using steps
+   of size H, or with adaptive methods starting with H, and keeping the
+   local errors below TOL.  ode_solve() fills Y with the state at time
+   T, which must not be less than the last time asked for, and
+   ode_set() changes the state at that last time to Y. */
+
+void ode_init(ODE *ode, int n, ODEFUNC f, double *y, double h,
+              char *method, double tol);
+void ode_solve(ODE *ode, double t, double *y);
+void ode_set(ODE *ode, double *y);
 
 /* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
 
@@ -128,6 +198,19 @@ double random_range(double low, double high);
 double random_gauss(void);
 
 
+/* Independent random number streams for code that runs in several
+   threads at once, where random() can not be shared.  Each stream is
+   a 32-bit xorshift generator; streams with different numbers but the
+   same seed give unrelated sequences. */
+
+typedef struct RANDSTREAM {
+  unsigned long x, y, z, w;
+} RANDSTREAM;
+
+void   random_stream_init(RANDSTREAM *rs, unsigned long seed, int stream);
+double random_stream_range(RANDSTREAM *rs, double low, double high);
+
+
 /* Function to get memory with check for failure built in. */
 
 void *xmalloc(size_t bytes);
@@ -137,6 +220,40 @@ void *xmalloc(size_t bytes);
 
 int **read_pbm_file(char *fname, int *w, int *h);
 
+
+/* Run fn(task, arg) for every task in 0 .. ntasks - 1, spread over
+   nthreads threads (or all processors if nthreads <= 0).  Without
+   PTHREADS the tasks are simply run in order. */
+
+void parallel_tasks(int ntasks, int nthreads,
+                    void (*fn)(int task, void *arg), void *arg);
+
+
+/* The number of threads that parallel_tasks() would use for a given
+   nthreads, which is always 1 without PTHREADS. */
+
+int parallel_threads(int nthreads);
+
+
+/* A single lock for tasks run by parallel_tasks() to share something
+   that is not thread safe, such as the plot routines. */
+
+void parallel_lock(void);
+void parallel_unlock(void);
+
+/* Detection of cycles in a sequence of values, by Brent's method.
+   cycle_check() is given each value in turn, and returns the period
+   once the sequence has repeated twice to within TOL with a period of
+   at most MAXPER, and zero until then. */
+
+typedef struct CYCLE {
+  double x, tol;
+  int dist, power, max, per;
+} CYCLE;
+
+void cycle_init(CYCLE *c, double tol, int maxper);
+int  cycle_check(CYCLE *c, double x);
+
 /* Miscelaneous macros. */
 
 #define MIN(x, y)     ((x) < (y) ? (x) : (y))
@@ -6,6 +6,23 @@
  *   auto-scaling builtin to it.  Thus, the implementation could be
  *   made a bit simpler by exploiting it, but I decided not to
  *   bother fixing what already worked.
+ *
+ *   The copies of the seed image are found by walking the tree of
+ *   compositions of the rules with an explicit stack.  Branches whose
+ *   copies all land on a single pixel are drawn as that pixel and not
+ *   expanded any further, which keeps large values of -depth
+ *   affordable without changing the image.  With -threads, the top
+ *   levels of the tree are expanded into enough subtrees to keep every
+ *   thread busy, and the subtrees are drawn in parallel, each thread
+ *   into a private cover of the plot, and the covers are merged at
+ *   the end.  With a vector terminal (ps or svg), the threads take
+ *   turns with the plot routines instead.
+ *
+ *   With -super K, the copies are drawn on a grid that is K times
+ *   finer than the plot, and each K by K block of the grid becomes
+ *   one pixel with one of LEVELS gray levels that says how much of
+ *   the block is covered, which gives smooth edges instead of jagged
+ *   ones.
  * MISCELLANY
  *   There is a shell script called 'ifscma' supplied with the source
  *   code that has a simple interface that allows you to reference
@@ -38,9 +55,10 @@
 
 double a[MAXRULES], b[MAXRULES], c[MAXRULES];
 double d[MAXRULES], e[MAXRULES], f[MAXRULES];
-double **x, **y, bw = 1.0, bh = 1.0;
+double x[POINTS], y[POINTS], bw = 1.0, bh = 1.0;
 int depth = 5, border = 10, width = 640, height = 480, L = 0;
-int boxwidth, xoff, yoff, rules, invert = 0, mag = 1;
+int boxwidth, xoff, yoff, rules, invert = 0, mag = 1, threads = 1;
+int super = 1, levels = 2;
 char *term = NULL, *infile = "-";
 
 char help_string[] =  "\
@@ -63,6 +81,10 @@ OPTION options[] = {
   { "-term",   OPT_STRING,  &term,   "How to plot points."               },
   { "-inv",    OPT_SWITCH,  &invert, "Invert colors?" },
   { "-mag",    OPT_INT,     &mag,    "Magnification factor." },
+  { "-threads", OPT_INT,    &threads,
+    "Number of threads.  If zero, use all processors." },
+  { "-super",  OPT_INT,     &super,  "Supersampling factor."            },
+  { "-levels", OPT_INT,     &levels, "Number of gray levels for -super." },
   { NULL,      OPT_NULL,    NULL,    NULL                                }
 };
 
@@ -126,49 +148,255 @@ void load_rules(char *fname)
 
 /* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
 
-static void compute_figure(int level)
+/* An affine transform, composed of all of the rules along one path
+   down the tree of copies, and the depth of the path. */
+
+typedef struct TRANSFORM {
+  double a, b, c, d, e, f;
+  int level;
+} TRANSFORM;
+
+/* Number of line segments to buffer before plotting. */
+
+#define BATCH 1024
+
+/* A buffer of line segments.  Every task gets its own, and draws the
+   segments into COVER if it is not NULL. */
+
+typedef struct SEGBUF {
+  double seg[4 * BATCH];
+  int n;
+  unsigned char *cover;
+} SEGBUF;
+
+/* Make a task for at least this many subtrees per thread, so that
+   threads that finish early can pick up more of the work. */
+
+#define TASKS_PER_THREAD 8
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+/* Plot the buffered segments, either into the task's cover or, taking
+   turns with other tasks, into the plot. */
+
+static void flush_segments(SEGBUF *sb)
+{
+  if(sb->cover)
+    plot_cover_lines(sb->cover, sb->n, sb->seg);
+  else {
+    parallel_lock();
+    plot_lines(sb->n, sb->seg, 1);
+    parallel_unlock();
+  }
+  sb->n = 0;
+}
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+/* Save one line segment, given in the unit box, and plot the buffered
+   segments when the buffer is full. */
+
+static void add_segment(SEGBUF *sb, double x1, double y1,
+                        double x2, double y2)
 {
-  int i, j, ax, ay, bx, by;
-
-  /* If this is not the bottom-most recursive level... */
-  if(level < depth + 1) {
-    /* For each rule... */
-    for(i = 0; i < rules; i++) {
-      /* For each point in the seed image ... */
-      for(j = 0; j < POINTS; j++) {
-        /* ... transform the point in the seed image by the proper
-         * affine rule.
-         */
-        x[level][j] = a[i] * x[level-1][j] + b[i] * y[level-1][j] + e[i];
-        y[level][j] = c[i] * x[level-1][j] + d[i] * y[level-1][j] + f[i];
+  double *s;
+
+  s = sb->seg + 4 * sb->n;
+  s[0] = (int) (x1 * (boxwidth - 1) + xoff + 0.5);
+  s[1] = height - (int) (y1 * (boxwidth - 1) + yoff + 0.5);
+  s[2] = (int) (x2 * (boxwidth - 1) + xoff + 0.5);
+  s[3] = height - (int) (y2 * (boxwidth - 1) + yoff + 0.5);
+  if(++sb->n == BATCH)
+    flush_segments(sb);
+}
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+/* Compose the transform t with rule i, applying the rule first, and
+   store it in u.  The transforms of the copies of the seed image
+   below u are then all t composed with something, so that the copies
+   lie inside the copy of the seed box under t. */
+
+static void compose(TRANSFORM *u, TRANSFORM *t, int i)
+{
+  u->a = t->a * a[i] + t->b * c[i];
+  u->b = t->a * b[i] + t->b * d[i];
+  u->c = t->c * a[i] + t->d * c[i];
+  u->d = t->c * b[i] + t->d * d[i];
+  u->e = t->a * e[i] + t->b * f[i] + t->e;
+  u->f = t->c * e[i] + t->d * f[i] + t->f;
+  u->level = t->level + 1;
+}
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+/* A box from (hullx[0], hully[0]) to (hullx[1], hully[1]) that holds
+   the seed image and that every rule maps into itself, if one was
+   found, in which case hull is set. */
+
+static double hullx[2], hully[2];
+static int hull;
+
+/* Try to find the box, by growing the box around the seed image until
+   it holds its images under the rules, and then checking that a box a
+   little larger than that is mapped into itself. */
+
+static void find_hull(void)
+{
+  double lox, hix, loy, hiy, u, v, m;
+  int i, j, k, ok;
+
+  hullx[0] = x[1]; hullx[1] = x[0];
+  hully[0] = y[0]; hully[1] = y[2];
+  for(k = 0; k < 1000; k++) {
+    lox = x[1]; hix = x[0]; loy = y[0]; hiy = y[2];
+    for(i = 0; i < rules; i++)
+      for(j = 0; j < 4; j++) {
+        u = a[i] * hullx[j & 1] + b[i] * hully[j >> 1] + e[i];
+        v = c[i] * hullx[j & 1] + d[i] * hully[j >> 1] + f[i];
+        lox = MIN(lox, u); hix = MAX(hix, u);
+        loy = MIN(loy, v); hiy = MAX(hiy, v);
       }
-      /* Descend to the next recursion level. */
-      compute_figure(level + 1);
-    }
+    hullx[0] = lox; hullx[1] = hix;
+    hully[0] = loy; hully[1] = hiy;
   }
-  /* This is the bottom-most recursion level, so plot the points. */
-  else {
-    /* For all points in the seed image except the 'L' ... */
-    for(i = 0; i < POINTS - 3; i++) {
-      /* ... calculate two endpoints and draw the line. */
-      ax = x[level-1][i] * (boxwidth - 1) + xoff + 0.5;
-      ay = height - (int)(y[level-1][i] * (boxwidth - 1) + yoff + 0.5);
-      bx = x[level-1][(i + 1) % (POINTS - 3)] * (boxwidth - 1) + xoff + 0.5;
-      by = height - (int)(y[level-1][(i + 1) % (POINTS - 3)] *
-                          (boxwidth - 1) + yoff + 0.5);
-      plot_line(ax, ay, bx, by, 1);
+
+  m = 1e-6 * MAX(hullx[1] - hullx[0], hully[1] - hully[0]);
+  hullx[0] -= m; hullx[1] += m;
+  hully[0] -= m; hully[1] += m;
+  for(i = 0, ok = 1; i < rules; i++)
+    for(j = 0; j < 4; j++) {
+      u = a[i] * hullx[j & 1] + b[i] * hully[j >> 1] + e[i];
+      v = c[i] * hullx[j & 1] + d[i] * hully[j >> 1] + f[i];
+      ok &= (u >= hullx[0] && u <= hullx[1] &&
+             v >= hully[0] && v <= hully[1]);
     }
-    if(L)
-      /* If we should plot the 'L' as well, then do it. */
-      for(i = 4; i < POINTS - 1; i++) {
-        /* ... calculate two endpoints and draw the line. */
-        ax = x[level-1][i] * (boxwidth - 1) + xoff + 0.5;
-        ay = height - (int)(y[level-1][i] * (boxwidth - 1) + yoff + 0.5);
-        bx = x[level-1][i + 1] * (boxwidth - 1) + xoff + 0.5;
-        by = height - (int)(y[level-1][i + 1] * (boxwidth - 1) + yoff + 0.5);
-        plot_line(ax, ay, bx, by, 1);
+  hull = ok;
+}
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+/* Draw the seed image under every composition of rules that extends
+   ROOT down to DEPTH.  The tree of copies is walked with an explicit
+   stack of composed transforms instead of recursion, so that no copy
+   of the seed image is computed until it is drawn.  Everything drawn
+   below a transform lies inside its copy of the hull, so if all of
+   the corners of that copy are rounded by add_segment() to the same
+   pixel, then so is everything below it, and the branch is not
+   expanded any further but drawn as that one pixel. */
+
+static void compute_figure(TRANSFORM *root, SEGBUF *sb)
+{
+  TRANSFORM *stack, t;
+  double px[POINTS], py[POINTS], s;
+  int i, top, ix = 0, iy = 0, cull;
+
+  /* Each level leaves at most RULES - 1 entries behind on the stack. */
+  stack = xmalloc(((depth - root->level) * (rules - 1) + 2) *
+                  sizeof(TRANSFORM));
+  stack[0] = *root;
+  top = 1;
+  s = boxwidth - 1;
+
+  while(top > 0) {
+    t = stack[--top];
+
+    /* Cull branches whose box lands on a single pixel. */
+    for(i = 0, cull = hull; i < 4 && cull; i++) {
+      px[i] = t.a * hullx[i & 1] + t.b * hully[i >> 1] + t.e;
+      py[i] = t.c * hullx[i & 1] + t.d * hully[i >> 1] + t.f;
+      if(i == 0) {
+        ix = (int) (px[0] * s + xoff + 0.5);
+        iy = (int) (py[0] * s + yoff + 0.5);
       }
-  } 
+      else
+        cull = ((int) (px[i] * s + xoff + 0.5) == ix &&
+                (int) (py[i] * s + yoff + 0.5) == iy);
+    }
+    if(cull) {
+      add_segment(sb, px[0], py[0], px[0], py[0]);
+      continue;
+    }
+
+    /* If this is not the bottom-most level, push the composition of
+     * each rule with this transform, in reverse so that the rules
+     * are visited in order.
+     */
+    if(t.level < depth) {
+      for(i = rules - 1; i >= 0; i--)
+        compose(stack + top++, &t, i);
+      continue;
+    }
+
+    /* Otherwise, transform the seed image and draw the box ... */
+    for(i = 0; i < POINTS; i++) {
+      px[i] = t.a * x[i] + t.b * y[i] + t.e;
+      py[i] = t.c * x[i] + t.d * y[i] + t.f;
+    }
+    for(i = 0; i < POINTS - 3; i++)
+      add_segment(sb, px[i], py[i], px[(i + 1) % (POINTS - 3)],
+                  py[(i + 1) % (POINTS - 3)]);
+    /* ... and the 'L' as well, if we should. */
+    if(L)
+      for(i = 4; i < POINTS - 1; i++)
+        add_segment(sb, px[i], py[i], px[i + 1], py[i + 1]);
+  }
+  free(stack);
+}
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+/* Draw the subtree under one of the transforms in ARG, into a cover
+   if there are any. */
+
+static int covers = 0;
+
+static void figure_task(int task, void *arg)
+{
+  TRANSFORM *roots = arg;
+  SEGBUF *sb;
+
+  sb = xmalloc(sizeof(SEGBUF));
+  sb->n = 0;
+  sb->cover = covers ? plot_cover_take() : NULL;
+  compute_figure(roots + task, sb);
+  flush_segments(sb);
+  if(sb->cover) plot_cover_give(sb->cover);
+  free(sb);
+}
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+/* Split the tree into subtrees by expanding its top levels until there
+   are enough to keep every thread busy, and draw them in parallel.
+   Unless the plot is a vector one, every thread draws into a cover of
+   its own, and the covers are merged at the end. */
+
+static void compute_figures(void)
+{
+  TRANSFORM *roots, *next;
+  int i, j, n, want;
+
+  want = (threads == 1) ? 1 : TASKS_PER_THREAD * parallel_threads(threads);
+  roots = xmalloc(sizeof(TRANSFORM));
+  roots[0].a = roots[0].d = 1.0;
+  roots[0].b = roots[0].c = roots[0].e = roots[0].f = 0.0;
+  roots[0].level = 0;
+  for(n = 1; n < want && roots[0].level < depth; n *= rules) {
+    next = xmalloc(n * rules * sizeof(TRANSFORM));
+    for(i = 0; i < n; i++)
+      for(j = 0; j < rules; j++)
+        compose(next + i * rules + j, roots + i, j);
+    free(roots);
+    roots = next;
+  }
+  covers = (n > 1 && !plot_vector) ? MIN(parallel_threads(threads), n) : 0;
+  if(covers)
+    plot_covers_init(covers);
+  parallel_tasks(n, threads, figure_task, roots);
+  if(covers)
+    plot_covers_finish(1);
+  free(roots);
 }
 
 /* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
@@ -177,42 +405,38 @@ int main(int argc, char **argv)
 { 
   extern int plot_mag;
   extern int plot_inverse;
-  int i;
-
+  extern int plot_super;
   get_options(argc, argv, options, help_string);
 
   load_rules(infile);
 
   plot_mag = mag;
   plot_inverse = invert;
-  plot_init(width, height, 2, term);
+  plot_super = super;
+  width *= super;
+  height *= super;
+  border *= super;
+  plot_init(width, height, (super > 1) ? levels : 2, term);
   plot_set_all(0);
   
-  /* Get space to hold the tranformations to the requested depth. */
-  x = xmalloc((depth + 1) * sizeof(double *));
-  y = xmalloc((depth + 1) * sizeof(double *));
-  for(i = 0; i < depth + 1; i++) {
-    x[i] = xmalloc(POINTS * sizeof(double));
-    y[i] = xmalloc(POINTS * sizeof(double));
-  }
-  
   boxwidth = MIN(width, height) - 2 * border;
   xoff = (width - boxwidth) / 2;
   yoff = (height - boxwidth) / 2;
 
   /* Define the points for a simple box. */
-  x[0][0] = (1 + bw) / 2; y[0][0] = (1 - bh) / 2;
-  x[0][1] = (1 - bw) / 2; y[0][1] = (1 - bh) / 2;
-  x[0][2] = (1 - bw) / 2; y[0][2] = (1 + bh) / 2;
-  x[0][3] = (1 + bw) / 2; y[0][3] = (1 + bh) / 2;
+  x[0] = (1 + bw) / 2; y[0] = (1 - bh) / 2;
+  x[1] = (1 - bw) / 2; y[1] = (1 - bh) / 2;
+  x[2] = (1 - bw) / 2; y[2] = (1 + bh) / 2;
+  x[3] = (1 + bw) / 2; y[3] = (1 + bh) / 2;
 
   /* Define the points for an 'L' in the box. */
-  x[0][4] = 0.5; y[0][4] = y[0][0] + bh * 0.1;
-  x[0][5] = x[0][1] + bh * 0.1; y[0][5] = y[0][4];
-  x[0][6] = x[0][5]; y[0][6] = y[0][2] - bh * 0.1;
+  x[4] = 0.5; y[4] = y[0] + bh * 0.1;
+  x[5] = x[1] + bh * 0.1; y[5] = y[4];
+  x[6] = x[5]; y[6] = y[2] - bh * 0.1;
 
   /* Shazam. */
-  compute_figure(1);
+  find_hull();
+  compute_figures();
   plot_finish();
   exit(0);
 }
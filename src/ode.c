@@ -0,0 +1,314 @@
+
+/* NAME
+ *   ode.c
+ * PURPOSE
+ *   Numerical integration of systems of ordinary differential
+ *   equations, shared by the programs that simulate flows.  A program
+ *   asks for the state at a sequence of increasing output times with
+ *   ode_solve(), and the integrator takes whatever steps it needs to
+ *   get there.  The methods are:
+ *
+ *   euler: the second-order Euler's (Heun's) method with a fixed step,
+ *   which is what the programs have always used.
+ *
+ *   rk4: the classical fourth-order Runge-Kutta method with a fixed
+ *   step.
+ *
+ *   rk23: the Bogacki-Shampine 3(2) pair with adaptive steps, and
+ *   cubic Hermite interpolation between them.
+ *
+ *   rk45: the Dormand-Prince 5(4) pair with adaptive steps, and its
+ *   fourth-order continuous extension between them.
+ *
+ *   The fixed step methods take steps of exactly the size given to
+ *   ode_init(), so the output times should be multiples of it.  The
+ *   adaptive methods keep an estimate of the local error of every
+ *   step below TOL, relative to the size of each variable or
+ *   absolute for variables smaller than one, and step right past the
+ *   output times, which are filled in by interpolation.  Both pairs
+ *   reuse the last derivative of a step as the first of the next, so
+ *   a step costs 3 or 6 evaluations of the derivatives.
+ */
+
+#include <math.h>
+#include "misc.h"
+
+#define ODE_EULER 0
+#define ODE_RK4   1
+#define ODE_RK23  2
+#define ODE_RK45  3
+
+/* The Dormand-Prince tableau.  The last row of A is also the fifth
+   order solution, E is the difference between the two solutions, and
+   P gives the coefficients of the continuous extension in powers of
+   the fraction of the step.  The systems are autonomous, so the nodes
+   of the tableau are not needed. */
+
+static const double dp_a[7][6] = {
+  { 0 },
+  { 1.0 / 5 },
+  { 3.0 / 40, 9.0 / 40 },
+  { 44.0 / 45, -56.0 / 15, 32.0 / 9 },
+  { 19372.0 / 6561, -25360.0 / 2187, 64448.0 / 6561, -212.0 / 729 },
+  { 9017.0 / 3168, -355.0 / 33, 46732.0 / 5247, 49.0 / 176,
+    -5103.0 / 18656 },
+  { 35.0 / 384, 0, 500.0 / 1113, 125.0 / 192, -2187.0 / 6784, 11.0 / 84 }
+};
+static const double dp_e[7] = {
+  71.0 / 57600, 0, -71.0 / 16695, 71.0 / 1920, -17253.0 / 339200,
+  22.0 / 525, -1.0 / 40
+};
+static const double dp_p[7][4] = {
+  { 1, -8048581381.0 / 2820520608, 8663915743.0 / 2820520608,
+    -12715105075.0 / 11282082432 },
+  { 0, 0, 0, 0 },
+  { 0, 131558114200.0 / 32700410799, -68118460800.0 / 10900136933,
+    87487479700.0 / 32700410799 },
+  { 0, -1754552775.0 / 470086768, 14199869525.0 / 1410260304,
+    -10690763975.0 / 1880347072 },
+  { 0, 127303824393.0 / 49829197408, -318862633887.0 / 49829197408,
+    701980252875.0 / 199316789632 },
+  { 0, -282668133.0 / 205662961, 2019193451.0 / 616988883,
+    -1453857185.0 / 822651844 },
+  { 0, 40617522.0 / 29380423, -110615467.0 / 29380423,
+    69997945.0 / 29380423 }
+};
+
+/* The Bogacki-Shampine tableau, laid out the same way. */
+
+static const double bs_a[4][3] = {
+  { 0 },
+  { 1.0 / 2 },
+  { 0, 3.0 / 4 },
+  { 2.0 / 9, 1.0 / 3, 4.0 / 9 }
+};
+static const double bs_e[4] = {
+  -5.0 / 72, 1.0 / 12, 1.0 / 9, -1.0 / 8
+};
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+void ode_init(ODE *ode, int n, ODEFUNC f, double *y, double h,
+              char *method, double tol)
+{
+  int i;
+
+  if(n > ODE_MAXDIM) {
+    fprintf(stderr, "ode_init: too many variables (%d).\n", n);
+    exit(1);
+  }
+  if(!strcmp(method, "euler")) ode->method = ODE_EULER;
+  else if(!strcmp(method, "rk4")) ode->method = ODE_RK4;
+  else if(!strcmp(method, "rk23")) ode->method = ODE_RK23;
+  else if(!strcmp(method, "rk45")) ode->method = ODE_RK45;
+  else {
+    fprintf(stderr, "Bad option passed to -method: \"%s\"\n", method);
+    exit(1);
+  }
+  ode->n = n;
+  ode->f = f;
+  ode->h = h;
+  ode->tol = tol;
+  ode->t = ode->t0 = ode->tout = 0;
+  ode->nfev = ode->nsteps = 0;
+  for(i = 0; i < n; i++)
+    ode->y[i] = ode->y0[i] = y[i];
+  ode->f(ode->y, ode->k[0]);
+  ode->nfev++;
+}
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+/* Compute stage S of a Runge-Kutta step of size H with the tableau row
+   A, leaving it in k[S]. */
+
+static void ode_stage(ODE *ode, int s, const double *a, double h)
+{
+  double tmp[ODE_MAXDIM];
+  int i, j;
+
+  for(i = 0; i < ode->n; i++) {
+    tmp[i] = ode->y[i];
+    for(j = 0; j < s; j++)
+      tmp[i] += h * a[j] * ode->k[j][i];
+  }
+  ode->f(tmp, ode->k[s]);
+  ode->nfev++;
+}
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+/* Take one step with a fixed step method.  On entry and exit, k[0] holds
+   the derivatives at the current state. */
+
+static void ode_fixed_step(ODE *ode)
+{
+  double tmp[ODE_MAXDIM], h = ode->h;
+  int i;
+
+  if(ode->method == ODE_EULER) {
+    for(i = 0; i < ode->n; i++)
+      tmp[i] = h * ode->k[0][i] + ode->y[i];
+    ode->f(tmp, ode->k[1]);
+    for(i = 0; i < ode->n; i++)
+      ode->y[i] += 0.5 * h * (ode->k[0][i] + ode->k[1][i]);
+    ode->nfev++;
+  }
+  else {
+    for(i = 0; i < ode->n; i++)
+      tmp[i] = ode->y[i] + 0.5 * h * ode->k[0][i];
+    ode->f(tmp, ode->k[1]);
+    for(i = 0; i < ode->n; i++)
+      tmp[i] = ode->y[i] + 0.5 * h * ode->k[1][i];
+    ode->f(tmp, ode->k[2]);
+    for(i = 0; i < ode->n; i++)
+      tmp[i] = ode->y[i] + h * ode->k[2][i];
+    ode->f(tmp, ode->k[3]);
+    for(i = 0; i < ode->n; i++)
+      ode->y[i] += h / 6 * (ode->k[0][i] + 2 * ode->k[1][i] +
+                            2 * ode->k[2][i] + ode->k[3][i]);
+    ode->nfev += 3;
+  }
+  ode->t += h;
+  ode->f(ode->y, ode->k[0]);
+  ode->nfev++;
+  ode->nsteps++;
+}
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+/* Take one accepted step with an adaptive method, shrinking the step
+   size until the error is small enough, and pick the size of the next
+   step.  The stages of the step are left in k[] for interpolation,
+   except for the first, which is saved in k0[] since ode_solve()
+   replaces it with the last (the derivatives at the new state). */
+
+static void ode_adaptive_step(ODE *ode)
+{
+  const double *e, *a;
+  double ynew[ODE_MAXDIM], err, sc, d, fac;
+  int i, j, s, stages, order, rejected = 0;
+
+  if(ode->method == ODE_RK45) {
+    stages = 7; order = 4; e = dp_e;
+  }
+  else {
+    stages = 4; order = 2; e = bs_e;
+  }
+  for(i = 0; i < ode->n; i++)
+    ode->k0[i] = ode->k[0][i];
+
+  for(;;) {
+    for(s = 1; s < stages; s++) {
+      a = (ode->method == ODE_RK45) ? dp_a[s] : bs_a[s];
+      ode_stage(ode, s, a, ode->h);
+    }
+    /* The last stage was evaluated at the new state, so recompute that
+     * state the same way.
+     */
+    a = (ode->method == ODE_RK45) ? dp_a[stages - 1] : bs_a[stages - 1];
+    for(i = 0, err = 0; i < ode->n; i++) {
+      ynew[i] = ode->y[i];
+      for(j = 0; j < stages - 1; j++)
+        ynew[i] += ode->h * a[j] * ode->k[j][i];
+      for(j = 0, d = 0; j < stages; j++)
+        d += e[j] * ode->k[j][i];
+      sc = ode->tol * (1 + MAX(fabs(ode->y[i]), fabs(ynew[i])));
+      err += SQR(ode->h * d / sc);
+    }
+    err = sqrt(err / ode->n);
+
+    /* The usual controller, limited to a factor of five either way,
+     * and never growing right after a rejected step.
+     */
+    if(err != err) fac = 0.2;
+    else if(err == 0) fac = 5;
+    else fac = MIN(5, MAX(0.2, 0.9 * pow(err, -1.0 / (order + 1))));
+    if(err <= 1) break;
+    ode->h *= MIN(fac, 1);
+    rejected = 1;
+  }
+  if(rejected) fac = MIN(fac, 1);
+  ode->t0 = ode->t;
+  ode->h0 = ode->h;
+  ode->t += ode->h;
+  ode->h *= fac;
+  for(i = 0; i < ode->n; i++) {
+    ode->y0[i] = ode->y[i];
+    ode->y[i] = ynew[i];
+  }
+  ode->nsteps++;
+}
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+/* Fill Y with the state at time T, which is within the last step. */
+
+static void ode_interpolate(ODE *ode, double t, double *y)
+{
+  double x, h = ode->h0, p[4], q, y0, y1, f0, f1;
+  int i, j, l;
+
+  x = (t - ode->t0) / h;
+  if(ode->method == ODE_RK45) {
+    for(l = 0; l < 4; l++)
+      p[l] = (l == 0) ? x : p[l - 1] * x;
+    for(i = 0; i < ode->n; i++) {
+      for(j = 0, q = 0; j < 7; j++)
+        q += (j ? ode->k[j][i] : ode->k0[i]) *
+          (dp_p[j][0] * p[0] + dp_p[j][1] * p[1] +
+           dp_p[j][2] * p[2] + dp_p[j][3] * p[3]);
+      y[i] = ode->y0[i] + h * q;
+    }
+  }
+  else
+    for(i = 0; i < ode->n; i++) {
+      y0 = ode->y0[i]; y1 = ode->y[i];
+      f0 = h * ode->k0[i]; f1 = h * ode->k[3][i];
+      y[i] = (1 - x) * y0 + x * y1 +
+        x * (x - 1) * ((1 - 2 * x) * (y1 - y0) + (x - 1) * f0 + x * f1);
+    }
+}
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+void ode_solve(ODE *ode, double t, double *y)
+{
+  int i, last, n = ode->n;
+
+  if(ode->method <= ODE_RK4) {
+    while(ode->t < t - 0.5 * ode->h)
+      ode_fixed_step(ode);
+    for(i = 0; i < n; i++)
+      y[i] = ode->y[i];
+  }
+  else {
+    last = (ode->method == ODE_RK45) ? 6 : 3;
+    while(ode->t < t) {
+      ode_adaptive_step(ode);
+      for(i = 0; i < n; i++)
+        ode->k[0][i] = ode->k[last][i];
+    }
+    if(ode->t == t)
+      for(i = 0; i < n; i++)
+        y[i] = ode->y[i];
+    else
+      ode_interpolate(ode, t, y);
+  }
+  ode->tout = t;
+}
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+void ode_set(ODE *ode, double *y)
+{
+  int i;
+
+  ode->t = ode->t0 = ode->tout;
+  for(i = 0; i < ode->n; i++)
+    ode->y[i] = ode->y0[i] = y[i];
+  ode->f(ode->y, ode->k[0]);
+  ode->nfev++;
+}
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
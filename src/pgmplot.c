@@ -8,6 +8,8 @@
  * PURPOSE
  *   Plot routines to emit pgm files to stdout.  Data is stored in a
  *   buffer and is not emmited until the pgm_pgmplot_finish() call.
+ *   Calls to pgmplot_frame() emit intermediate images, so that a
+ *   progressive plot becomes a stream of concatenated pgm files.
  */
 
 #include "misc.h"
@@ -24,14 +26,21 @@ int pgmplot_levels, pgmplot_width, pgmplot_height;
 
 /* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
 
+static void pgmplot_header(int width, int height, int levels)
+{
+  printf("P5\n");
+  printf("%d %d\n", width, height);
+  printf("%d\n", levels - 1);
+}
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
 void pgmplot_init(int width, int height, int levels)
 {
   int i, j;
 
   levels = (levels > 256) ? 256 : levels;
-  printf("P5\n");
-  printf("%d %d\n", width, height);
-  printf("%d\n", levels - 1);
+  pgmplot_header(width, height, levels);
 
   pgmplot_data = malloc(width * sizeof(unsigned char *));
   for(i = 0; i < width; i++) {
@@ -71,5 +80,17 @@ void pgmplot_finish(void)
 
 /* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
 
+/* Emit the current image and start the header of the next one.  The
+   final image of the stream is written by pgmplot_finish(). */
+
+void pgmplot_frame(void)
+{
+  pgmplot_finish();
+  pgmplot_header(pgmplot_width, pgmplot_height, pgmplot_levels);
+  fflush(stdout);
+}
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
 
 
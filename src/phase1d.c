@@ -114,12 +114,37 @@ void plot_arrow(double x1, double y1, double x2, double y2)
 
 #include "maps1d.c"
 
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+/* Draw the trajectory of map number MAP from X after the skipped
+   points, using ORBIT to hold its points. */
+
+void draw_orbit(int map, double x, double *orbit)
+{
+  int i;
+  double y;
+
+  orbit[0] = map1d_iterate(map, x, r, skip);
+  map1d_orbit(map, orbit[0], r, points, orbit + 1);
+  for(i = 0; i < points; i++) {
+    x = orbit[i]; y = orbit[i + 1];
+    plot_line(x, x, x, y, 1);
+    plot_line(x, y, y, y, 1);
+    if(arrows) {
+      plot_arrow(x, x, x, y);
+      plot_arrow(x, y, y, y);
+    }
+  }
+}
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
 int main(int argc, char **argv)
 {
   extern int plot_mag;
   extern int plot_inverse;
-  int i;
-  double x, y, xt, yt, xinc, (*f)(double, double);
+  int i, map;
+  double x, y, xt, yt, xinc, *orbit, (*f)(double, double);
 
   get_options(argc, argv, options, help_string);
 
@@ -131,6 +156,7 @@ int main(int argc, char **argv)
     plot_set_all(0);
 
   f = get_named_function(func);
+  map = get_named_map(func);
 
   /* First, draw the phase-space. */
   xinc = 1.0 / (width - 1);
@@ -144,32 +170,11 @@ int main(int argc, char **argv)
   /* Draw the identity line. */
   plot_line(0.0, 0.0, 1.0, 1.0, 1);
 
-  /* Draw the trajectory. */
-  for(i = 0, x = x0; i < points + skip; i++, x = y) {
-    y = f(x, r);
-    if(i >= skip) {
-      plot_line(x, x, x, y, 1);
-      plot_line(x, y, y, y, 1);
-      if(arrows) {
-        plot_arrow(x, x, x, y);
-        plot_arrow(x, y, y, y);
-      }
-    } 
-  }
-
-  /* Draw the second trajectory, if appropriate. */
+  /* Draw the trajectory, and the second one, if appropriate. */
+  orbit = xmalloc(sizeof(double) * (points + 1));
+  draw_orbit(map, x0, orbit);
   if(dx > 0.0)
-    for(i = 0, x = x0 + dx; i < points + skip; i++, x = y) {
-      y = f(x, r);
-      if(i >= skip) {
-        plot_line(x, x, x, y, 1);
-        plot_line(x, y, y, y, 1);
-        if(arrows) {
-          plot_arrow(x, x, x, y);
-          plot_arrow(x, y, y, y);
-        }
-      } 
-    }
+    draw_orbit(map, x0 + dx, orbit);
 
   plot_finish();
   exit(0);
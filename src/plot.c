@@ -16,6 +16,8 @@ extern "C" {
 PLOTPROTOS(pgm)
 PLOTPROTOS(raw)
 PLOTPROTOS(ps)
+PLOTPROTOS(svg)
+extern void pgmplot_frame(void);
 #ifdef  __cplusplus
 }
 #endif
@@ -30,6 +32,8 @@ static char *term_default = "Win";
 static char *term_default = "X11";
 PLOTPROTOS(x11)
 PLOTPROTOS(X11)
+extern void x11plot_frame(void);
+extern void X11plot_frame(void);
 #endif
 
 #ifdef PLOTVGA
@@ -52,6 +56,7 @@ static void (*_plot_init)(int width, int height, int levels);
 static void (*_plot_point)(int x, int y, int val);
 static void (*_plot_line)(int x1, int y1, int x2, int y2, int val);
 static void (*_plot_finish)(void);
+static void (*_plot_frame)(void);
 static void plot_line_internal(int x1, int y1, int x2, int y2, int val);
 
 
@@ -59,10 +64,14 @@ static void none_init(int width, int height, int levels);
 static void none_point(int i, int j, int val);
 static void none_line(int ax, int ay, int bx, int by, int val);
 static void none_finish(void);
+static void none_frame(void);
 
 int plot_levels, plot_width, plot_height, plot_inverse = 0, plot_mag = 1;
+int plot_super = 1, plot_vector = 0;
 double plot_xmin, plot_xmax, plot_ymin, plot_ymax;
 
+static void super_init(int width, int height, int levels);
+
 #define NORMX(x) \
   ((int) (plot_xmax == plot_xmin) ? plot_xmin : \
    ((((x) - plot_xmin) / (plot_xmax - plot_xmin)) * plot_width))
@@ -82,6 +91,7 @@ void plot_init(int width, int height, int levels, char *term)
 {
   if(!term) term = term_default;
 
+  _plot_frame = none_frame;
   if(0) ;
 #ifdef PLOTX11
   else if(strcmp(term, "x11") == 0) {
@@ -89,12 +99,14 @@ void plot_init(int width, int height, int levels, char *term)
     _plot_point = x11plot_point;
     _plot_line = x11plot_line;
     _plot_finish = x11plot_finish;
+    _plot_frame = x11plot_frame;
   }
   else if(strcmp(term, "X11") == 0) {
     _plot_init = X11plot_init;
     _plot_point = X11plot_point;
     _plot_line = X11plot_line;
     _plot_finish = X11plot_finish;
+    _plot_frame = X11plot_frame;
   }
 #endif
 #ifdef WIN32
@@ -125,11 +137,18 @@ void plot_init(int width, int height, int levels, char *term)
     _plot_line = psplot_line;
     _plot_finish = psplot_finish;
   }
+  else if(strcmp(term, "svg") == 0) {
+    _plot_init = svgplot_init;
+    _plot_point = svgplot_point;
+    _plot_line = svgplot_line;
+    _plot_finish = svgplot_finish;
+  }
   else if(strcmp(term, "pgm") == 0) {
     _plot_init = pgmplot_init;
     _plot_point = pgmplot_point;
     _plot_line = plot_line_internal;
     _plot_finish = pgmplot_finish;
+    _plot_frame = pgmplot_frame;
   }
   else if(strcmp(term, "raw") == 0) {
     _plot_init = rawplot_init;
@@ -147,7 +166,11 @@ void plot_init(int width, int height, int levels, char *term)
     plot_init(width, height, levels, term_default);
     return;
   }
-  _plot_init(width, height, levels);
+  plot_vector = (_plot_line == psplot_line || _plot_line == svgplot_line);
+  if(plot_super > 1)
+    super_init(width, height, levels);
+  else
+    _plot_init(width, height, levels);
   plot_levels = levels;
   plot_width = width;
   plot_height = height;
@@ -191,6 +214,26 @@ void plot_point(double x, double y, int val)
 
 /* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
 
+/* Plot N points with integer coordinates at once, so that programs
+   that compute many points can buffer them and hand them over in
+   large batches.  The points are scaled and clipped exactly as in
+   plot_point(). */
+
+void plot_pixels(int n, int *x, int *y, int val)
+{
+  int i, xi, yi;
+
+  val = COLOR(val);
+  for(i = 0; i < n; i++) {
+    xi = NORMX(x[i]); xi = LIMX(xi);
+    yi = NORMY(y[i]); yi = LIMY(yi);
+    if(!(xi < 0 || xi >= plot_width || yi < 0 || yi >= plot_height))
+      _plot_point(xi, yi, val);
+  }
+}
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
 void plot_line(double x1, double y1, double x2, double y2, int val)
 {
   int ax, ay, bx, by;
@@ -204,6 +247,226 @@ void plot_line(double x1, double y1, double x2, double y2, int val)
 
 /* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
 
+/* Plot N lines at once.  The endpoints of line i are (seg[4 * i],
+   seg[4 * i + 1]) and (seg[4 * i + 2], seg[4 * i + 3]), and they are
+   scaled exactly as in plot_line(). */
+
+void plot_lines(int n, double *seg, int val)
+{
+  int i, ax, ay, bx, by;
+
+  val = COLOR(val);
+  for(i = 0; i < n; i++, seg += 4) {
+    ax = NORMX(seg[0]); ax = LIMX(ax);
+    ay = NORMY(seg[1]); ay = LIMY(ay);
+    bx = NORMX(seg[2]); bx = LIMX(bx);
+    by = NORMY(seg[3]); by = LIMY(by);
+    _plot_line(ax, ay, bx, by, val);
+  }
+}
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+/* Threads that draw lines in parallel can each draw into a private
+   cover, with one byte for each pixel, row by row, and leave the
+   plot itself alone until the covers are merged at the end.
+   plot_covers_init() makes N covers, which should be the number of
+   threads.  A task takes one that no other task is using with
+   plot_cover_take() and gives it back with plot_cover_give(), so
+   the tasks need not know which thread runs them. */
+
+static unsigned char **plot_cover_pool;
+static int *plot_cover_busy, plot_cover_n;
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+void plot_covers_init(int n)
+{
+  int i;
+
+  plot_cover_n = n;
+  plot_cover_pool = xmalloc(sizeof(unsigned char *) * n);
+  plot_cover_busy = xmalloc(sizeof(int) * n);
+  for(i = 0; i < n; i++) {
+    plot_cover_pool[i] = xmalloc(plot_width * plot_height);
+    memset(plot_cover_pool[i], 0, plot_width * plot_height);
+    plot_cover_busy[i] = 0;
+  }
+}
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+unsigned char *plot_cover_take(void)
+{
+  int i;
+
+  parallel_lock();
+  for(i = 0; plot_cover_busy[i]; i++)
+    ;
+  plot_cover_busy[i] = 1;
+  parallel_unlock();
+  return(plot_cover_pool[i]);
+}
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+void plot_cover_give(unsigned char *cover)
+{
+  int i;
+
+  parallel_lock();
+  for(i = 0; plot_cover_pool[i] != cover; i++)
+    ;
+  plot_cover_busy[i] = 0;
+  parallel_unlock();
+}
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+/* Mark the pixels that plot_lines() would draw for the same N lines in
+   COVER instead of drawing them.  The pixels are those of the raster
+   drivers; plot_vector is set if the driver draws lines of its own,
+   and then only plot_lines() draws the same thing. */
+
+void plot_cover_lines(unsigned char *cover, int n, double *seg)
+{
+  int i, k, ax, ay, bx, by, len, xi, yi;
+  double t, dt;
+
+  for(i = 0; i < n; i++, seg += 4) {
+    ax = NORMX(seg[0]); ax = LIMX(ax);
+    ay = NORMY(seg[1]); ay = LIMY(ay);
+    bx = NORMX(seg[2]); bx = LIMX(bx);
+    by = NORMY(seg[3]); by = LIMY(by);
+    len = MAX(ABS(ax - bx), ABS(ay - by));
+    dt = (len > 0) ? 1.0 / len : 0.0;
+    for(k = 0, t = 0.0; k < len + 1; k++, t += dt) {
+      if(len > 0) {
+        xi = t * ax + (1.0 - t) * bx + 0.5;
+        yi = t * ay + (1.0 - t) * by + 0.5;
+      }
+      else {
+        xi = ax; yi = ay;
+      }
+      if(!(xi < 0 || xi >= plot_width || yi < 0 || yi >= plot_height))
+        cover[yi * plot_width + xi] = 1;
+    }
+  }
+}
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+/* Merge the covers into the first one, plot every pixel that is marked
+   in any of them with VAL, and free them. */
+
+void plot_covers_finish(int val)
+{
+  unsigned char *c;
+  int i, k, size;
+
+  size = plot_width * plot_height;
+  val = COLOR(val);
+  c = plot_cover_pool[0];
+  for(k = 1; k < plot_cover_n; k++) {
+    for(i = 0; i < size; i++)
+      c[i] |= plot_cover_pool[k][i];
+    free(plot_cover_pool[k]);
+  }
+  for(i = 0; i < size; i++)
+    if(c[i])
+      _plot_point(i % plot_width, i / plot_width, val);
+  free(c);
+  free(plot_cover_pool);
+  free(plot_cover_busy);
+}
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+/* Add one to the entry of COUNT, which has one entry for each pixel,
+   row by row, for the pixel that (x, y) falls in.  Points that are
+   off of the plot are ignored.  Nothing is drawn, so several threads
+   may do this at once with different counts. */
+
+void plot_count(unsigned int *count, double x, double y)
+{
+  int xi, yi;
+
+  xi = NORMX(x); xi = LIMX(xi);
+  yi = NORMY(y); yi = LIMY(yi);
+  if(!(xi < 0 || xi >= plot_width || yi < 0 || yi >= plot_height))
+    count[yi * plot_width + xi]++;
+}
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+static int compare_counts(const void *a, const void *b)
+{
+  unsigned int x = *(const unsigned int *) a, y = *(const unsigned int *) b;
+
+  return((x > y) - (x < y));
+}
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+/* Plot every pixel with a gray level that depends on its entry in
+   COUNT, as filled in by plot_count().  Pixels with a count of zero
+   get level zero, and all others at least level one.  With METHOD
+   "linear" the levels are proportional to the counts, with "log" to
+   their logarithms, and with "eq" the counts are equalized, so that
+   each level is used by about the same number of pixels. */
+
+void plot_counts(unsigned int *count, char *method)
+{
+  unsigned int *sorted, c, cmax = 0;
+  int i, n = plot_width * plot_height, m, lo, hi, val;
+  double scale;
+
+  if(strcmp(method, "linear") && strcmp(method, "log") &&
+     strcmp(method, "eq")) {
+    fprintf(stderr, "Bad tone mapping method: \"%s\"\n", method);
+    exit(1);
+  }
+  for(i = 0; i < n; i++)
+    cmax = MAX(cmax, count[i]);
+  if(cmax == 0) cmax = 1;
+
+  /* For equalization, the level of a count is set by the number of
+   * pixels with smaller counts, found by searching a sorted copy of
+   * the nonzero counts.
+   */
+  sorted = NULL;
+  m = 0;
+  if(!strcmp(method, "eq")) {
+    sorted = xmalloc(sizeof(unsigned int) * (n + 1));
+    for(i = 0; i < n; i++)
+      if(count[i]) sorted[m++] = count[i];
+    qsort(sorted, m, sizeof(unsigned int), compare_counts);
+  }
+  scale = !strcmp(method, "log") ? (plot_levels - 1) / log(1.0 + cmax) :
+    (double) (plot_levels - 1) / cmax;
+
+  for(i = 0; i < n; i++) {
+    val = 0;
+    if((c = count[i]) != 0) {
+      if(sorted) {
+        for(lo = 0, hi = m; lo < hi; )
+          if(sorted[(lo + hi) / 2] < c) lo = (lo + hi) / 2 + 1;
+          else hi = (lo + hi) / 2;
+        val = 1 + (double) lo / m * (plot_levels - 1);
+      }
+      else if(!strcmp(method, "log"))
+        val = log(1.0 + c) * scale;
+      else
+        val = c * scale;
+      val = MAX(1, MIN(plot_levels - 1, val));
+    }
+    _plot_point(i % plot_width, i / plot_width, COLOR(val));
+  }
+  if(sorted) free(sorted);
+}
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
 void plot_finish(void)
 {
   _plot_finish();
@@ -211,6 +474,173 @@ void plot_finish(void)
 
 /* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
 
+/* If plot_super is K > 1 when plot_init() is called, then the plot is
+   supersampled: everything is drawn into a coverage buffer that is K
+   times larger than the real plot in both directions, and each K by K
+   block of it becomes one pixel of the real plot, with a gray level
+   proportional to how much of the block is covered.  The program
+   sees a plot of the larger size and does not need to know about
+   any of this.
+
+   Drawing is treated as binary, with any nonzero value (before
+   plot_inverse is applied) covering a pixel and zero clearing it.
+   The coverage of a block is mapped onto the gray levels that the
+   program asked for, with every block that is covered at all getting
+   a nonzero level, so with two levels the real plot shows every block
+   that anything was drawn in.  The buffer holds one bit per pixel in
+   square tiles that are only allocated once something is drawn in
+   them, so plots that are mostly empty cost little more than the
+   real plot.
+
+   The vector drivers have no pixels to smooth, so they are not
+   supersampled.  They get everything scaled down to the size of the
+   real plot instead. */
+
+#define TILE 32
+
+static void (*super_point_real)(int x, int y, int val);
+static void (*super_line_real)(int ax, int ay, int bx, int by, int val);
+static void (*super_finish_real)(void);
+static void (*super_frame_real)(void);
+static unsigned int **super_tiles;
+static int super_tw, super_th;
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+static void super_point(int x, int y, int val)
+{
+  unsigned int *tile;
+  int t;
+
+  if(x < 0 || x >= plot_width || y < 0 || y >= plot_height) return;
+  val = COLOR(val);
+  t = (y / TILE) * super_tw + x / TILE;
+  if((tile = super_tiles[t]) == NULL) {
+    if(val == 0) return;
+    tile = super_tiles[t] = xmalloc(sizeof(unsigned int) * TILE);
+    memset(tile, 0, sizeof(unsigned int) * TILE);
+  }
+  if(val)
+    tile[y % TILE] |= 1U << (x % TILE);
+  else
+    tile[y % TILE] &= ~(1U << (x % TILE));
+}
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+/* Filter the coverage buffer down to the real plot, one row of blocks
+   at a time. */
+
+static void super_resolve(void)
+{
+  unsigned int *tile, word;
+  int *count, w, h, i, j, x, y, t, val;
+
+  w = plot_width / plot_super;
+  h = plot_height / plot_super;
+  count = xmalloc(sizeof(int) * w);
+  for(j = 0; j < h; j++) {
+    memset(count, 0, sizeof(int) * w);
+    for(y = j * plot_super; y < (j + 1) * plot_super; y++)
+      for(t = 0; t < super_tw; t++) {
+        if((tile = super_tiles[(y / TILE) * super_tw + t]) == NULL)
+          continue;
+        for(x = t * TILE, word = tile[y % TILE]; word; x++, word >>= 1)
+          if((word & 1) && x / plot_super < w)
+            count[x / plot_super]++;
+      }
+    for(i = 0; i < w; i++) {
+      val = (count[i] * (plot_levels - 1) + plot_super * plot_super / 2) /
+        (plot_super * plot_super);
+      if(count[i] > 0) val = MAX(val, 1);
+      super_point_real(i, j, plot_inverse ? plot_levels - 1 - val : val);
+    }
+  }
+  free(count);
+}
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+static void super_finish(void)
+{
+  int i;
+
+  super_resolve();
+  for(i = 0; i < super_tw * super_th; i++)
+    if(super_tiles[i]) free(super_tiles[i]);
+  free(super_tiles);
+  super_finish_real();
+}
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+static void super_frame(void)
+{
+  super_resolve();
+  super_frame_real();
+}
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+static void super_vector_point(int x, int y, int val)
+{
+  super_point_real(x / plot_super, y / plot_super, val);
+}
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+static void super_vector_line(int ax, int ay, int bx, int by, int val)
+{
+  super_line_real(ax / plot_super, ay / plot_super,
+                  bx / plot_super, by / plot_super, val);
+}
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+/* Put the supersampling routines in front of the real driver, or just
+   the scaling if it is a vector driver. */
+
+static void super_init(int width, int height, int levels)
+{
+  int i;
+
+  if(plot_vector) {
+    super_point_real = _plot_point;
+    super_line_real = _plot_line;
+    _plot_point = super_vector_point;
+    _plot_line = super_vector_line;
+    _plot_init(width / plot_super, height / plot_super, levels);
+    return;
+  }
+  super_point_real = _plot_point;
+  super_finish_real = _plot_finish;
+  super_frame_real = _plot_frame;
+  _plot_point = super_point;
+  _plot_line = plot_line_internal;
+  _plot_finish = super_finish;
+  _plot_frame = super_frame;
+
+  super_tw = (width + TILE - 1) / TILE;
+  super_th = (height + TILE - 1) / TILE;
+  super_tiles = xmalloc(sizeof(unsigned int *) * super_tw * super_th);
+  for(i = 0; i < super_tw * super_th; i++)
+    super_tiles[i] = NULL;
+  _plot_init(width / plot_super, height / plot_super, levels);
+}
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+/* Makes the current contents of the plot visible without ending the
+   plot.  Screen drivers simply flush, while the pgm driver emits a
+   complete image so that stdout becomes a stream of frames. */
+
+void plot_frame(void)
+{
+  _plot_frame();
+}
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
 static void plot_line_internal(int ax, int ay, int bx, int by, int val)
 {
   double tx, ty, t, dt;
@@ -283,3 +713,9 @@ static void none_finish(void)
 }
 
 /* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+static void none_frame(void)
+{
+}
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
@@ -25,7 +25,31 @@
  *   
  *   The program uses a second-order Euler's method to perform the
  *   numerical integration, which is sufficient for simple tasks such
- *   as this.
+ *   as this.  With -method, any of the integrators in ode.c can be
+ *   used instead.  The adaptive ones, rk23 and rk45, pick their own
+ *   steps to keep the error below TOL, and -dt then only sets the
+ *   time between the points that are plotted or printed.
+ *
+ *   The points printed with -data can be written as binary floats
+ *   with -format, which is much faster to write and to read back than
+ *   text and loses no precision, and thinned out with -stride.
+ *
+ *   With -ens N or -ensfile, the program integrates an ensemble of
+ *   trajectories at once instead of plotting one, and writes out
+ *   either the whole ensemble or its spread and how much of it has
+ *   diverged from a reference trajectory.  Ensembles are always
+ *   integrated with the second-order Euler's method.  See ensemble.c
+ *   for the details.
+ *
+ *   With -scan, the program instead plots the largest Lyapunov
+ *   exponent over a grid of two parameters or initial values, one
+ *   per pixel.  See lyapunov.c.
+ *
+ *   With -density, the points of the trajectory are counted in each
+ *   pixel instead of being joined by lines, and the counts are plotted
+ *   with LEVELS gray levels, mapped as given by -tone.  The points can
+ *   be split among several trajectories that are run in parallel with
+ *   -threads.  See density.c.
  * BUGS
  *   No sanity checks are performed to make sure that any of the
  *   options make sense.
@@ -43,11 +67,44 @@
 #include "misc.h"
 
 int width = 480, height = 480, skip = 2000, points = 5000;
-int delta = 20, data = 0, invert = 0, mag = 1;
+int delta = 20, data = 0, invert = 0, mag = 1, stride = 1;
 double alpha = 1.5, dt = 0.1;
 double factor = 0.2, xx0 = 0.5, yy0 = 0.5, zz0 = 0.5;
 char *xp = "x(t)", *yp = "y(t)";
-char *term = NULL;
+char *term = NULL, *method = "euler", *format = "text";
+double tol = 1e-6;
+int levels = 256, threads = 1;
+
+/* The system to numerically integrate; in this case, the
+   predator-prey system, with A as alpha.  If you want to modify this
+   code to work with another three-dimensional system, then this is
+   the only thing that you'll need to modify.  It is a macro so that
+   the same definition serves both myfunc() and the ensemble code in
+   ensemble.c. */
+
+#define FLOW(x, y, z, a, b, c, dx, dy, dz) \
+  do { \
+    (dx) = (x) * (1.1 - (x) / 2 - (y) / 2 - (z) / 10); \
+    (dy) = (y) * (-0.5 + (x) / 2 + (y) / 10 - (z) / 10); \
+    (dz) = (z) * ((a) + 0.2 - (a) * (x) - (y) / 10 - (z) / 10); \
+  } while(0)
+
+/* The Jacobian of the system at (X, Y, Z) times (U, V, W), for the
+   Lyapunov exponents computed in lyapunov.c. */
+
+#define TANGENT(x, y, z, a, b, c, u, v, w, du, dv, dw) \
+  do { \
+    (du) = (1.1 - (x) - (y) / 2 - (z) / 10) * (u) - (x) / 2 * (v) - \
+      (x) / 10 * (w); \
+    (dv) = (y) / 2 * (u) + (-0.5 + (x) / 2 + (y) / 5 - (z) / 10) * (v) - \
+      (y) / 10 * (w); \
+    (dw) = -(a) * (z) * (u) - (z) / 10 * (v) + \
+      ((a) + 0.2 - (a) * (x) - (y) / 10 - (z) / 5) * (w); \
+  } while(0)
+
+#include "ensemble.c"
+#include "lyapunov.c"
+#include "density.c"
 
 char help_string[] = "\
 The phase space of a three species predator-prey system, \
@@ -73,16 +130,26 @@ OPTION options[] = {
   { "-alpha",  OPT_DOUBLE,  &alpha,  "Value of the alpha parameter." },
   { "-delta",  OPT_INT,     &delta,  "Time delay term." },
   { "-dt",     OPT_DOUBLE,  &dt,     "Time step." },
+  { "-method", OPT_STRING,  &method, "euler, rk4, rk23, or rk45." },
+  { "-tol",    OPT_DOUBLE,  &tol,    "Error tolerance for rk23 and rk45." },
   { "-x0",     OPT_DOUBLE,  &xx0,    "Initial X value." },
   { "-y0",     OPT_DOUBLE,  &yy0,    "Initial Y value." },
   { "-z0",     OPT_DOUBLE,  &zz0,    "Initial Z value." },
   { "-data",   OPT_SWITCH,  &data,   "Don't plot, but print points." },
+  { "-format", OPT_STRING,  &format, "text, csv, f32, f64, or bin." },
+  { "-stride", OPT_INT,     &stride, "Print every STRIDE-th point." },
   { "-xp",     OPT_STRING,  &xp,     "X-coordinate for plot." },
   { "-yp",     OPT_STRING,  &yp,     "Y-coordinate for plot." },
   { "-factor", OPT_DOUBLE,  &factor, "Auto-scale expansion factor." },
   { "-inv",    OPT_SWITCH,  &invert, "Invert all colors?" },
   { "-mag",    OPT_INT,     &mag,    "Magnification factor." },
   { "-term",   OPT_STRING,  &term,   "How to plot points." },
+  { "-levels", OPT_INT,     &levels, "Gray levels for -density and -scan." },
+  { "-threads", OPT_INT,    &threads,
+    "Threads for -density and -scan.  If zero, use all processors." },
+  ENSEMBLE_OPTIONS,
+  LYAPUNOV_OPTIONS,
+  DENSITY_OPTIONS,
   { NULL,      OPT_NULL,    NULL,    NULL }
 };
 
@@ -113,32 +180,21 @@ void assign_pointer(double ***ptr, double *delays[3][2], char *str)
 
 /* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
 
-/* The function to numerically integrate; in this case, the
-   predator-prey system.  If you want to modify this code to work with
-   another three-dimensional system, then this is the only function
-   that you'll need to modify. */
+/* The derivatives of the system at one point. */
 
 void myfunc(double x, double y, double z,
             double *xx, double *yy, double *zz)
 {
-  *xx = x * (1.1 - x / 2 - y / 2 - z / 10);
-  *yy = y * (-0.5 + x / 2 + y / 10 - z / 10);
-  *zz = z * (alpha + 0.2 - alpha * x - y / 10 - z / 10);
+  FLOW(x, y, z, alpha, 0.0, 0.0, *xx, *yy, *zz);
 }
 
 /* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
 
-/* Perform one second-order Euler step. */
+/* The system in the form that the integrators in ode.c want. */
 
-void euler(double dt, double *x, double *y, double *z)
+void odefunc(double *s, double *ds)
 {
-  double x1, x2, y1, y2, z1, z2;
-  
-  myfunc(*x, *y, *z, &x1, &y1, &z1);
-  myfunc(dt * x1 + *x, dt * y1 + *y, dt * z1 + *z, &x2, &y2, &z2);
-  *x += 0.5 * dt * (x1 + x2);
-  *y += 0.5 * dt * (y1 + y2);
-  *z += 0.5 * dt * (z1 + z2);
+  myfunc(s[0], s[1], s[2], &ds[0], &ds[1], &ds[2]);
 }
 
 /* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
@@ -153,7 +209,8 @@ int main(int argc, char **argv)
   int ssz, si;
 
   /* Variables used to calculate the time evolution of the system. */
-  double x, y, z;
+  double x, y, z, s[3];
+  ODE ode;
 
   /* Buffers to store delay values of all three variables. */
   double *buffer[3];
@@ -173,13 +230,29 @@ int main(int argc, char **argv)
   double px, py, pxx = 0, pyy = 0, temp;
 
   get_options(argc, argv, options, help_string);
+  if(stride < 1) stride = 1;
+
+  if(density && !data) {
+    density_plot();
+    exit(0);
+  }
+  if(scan) {
+    lyapunov_scan(alpha, 0.0, 0.0, "alpha");
+    exit(0);
+  }
+  if(ens > 0 || ensfile) {
+    ensemble_run(alpha, 0.0, 0.0);
+    exit(0);
+  }
 
   /* Set up the pointers so that they refer to the proper values to
    * plot with respect to. */
   assign_pointer(&ppx, delays, xp);
   assign_pointer(&ppy, delays, yp);
 
-  if(!data) {
+  if(data)
+    data_init(format, "x y z");
+  else {
     plot_mag = mag;
     plot_inverse = invert;
     plot_init(width, height, 2, term);
@@ -194,6 +267,8 @@ int main(int argc, char **argv)
 
   /* Initialize the system. */
   x = xx0; y = yy0; z = zz0;
+  s[0] = x; s[1] = y; s[2] = z;
+  ode_init(&ode, 3, odefunc, s, dt, method, tol);
 
   /* Set insane minimum and maximum guesses. */
   xmin = ymin = 10e10;
@@ -203,7 +278,8 @@ int main(int argc, char **argv)
   for(i = 0; i < points + skip + ssz; i++) {
 
     /* Compute the time evolution of the system. */
-    euler(dt, &x, &y, &z);
+    ode_solve(&ode, (i + 1) * dt, s);
+    x = s[0]; y = s[1]; z = s[2];
 
     /* Save the state so that we can remember delayed values. */
     buffer[0][si] = x; buffer[1][si] = y; buffer[2][si] = z;
@@ -217,8 +293,8 @@ int main(int argc, char **argv)
     si = (si + 1) % ssz;
 
     if(data) {
-      if(i >= skip + ssz)
-        printf("%f\t%f\t%f\n", x, y, z);
+      if(i >= skip + ssz && (i - skip - ssz) % stride == 0)
+        data_write(s);
     }
     else {
       /* Get the point that we want to plot. */
@@ -250,7 +326,8 @@ int main(int argc, char **argv)
     }
   }
 
-  if(!data) plot_finish();
+  if(data) data_finish();
+  else plot_finish();
   exit(0);
 }
 
@@ -6,14 +6,35 @@
  * NAME
  *   psplot.c
  * PURPOSE
- *   Plot routines for postscript.
+ *   Plot routines for postscript.  Everything is passed through the
+ *   segment simplifier in vecplot.c before it is written.
  */
 
 
 #include "misc.h"
 
 int psplot_levels = 2, psplot_width = 640, psplot_height = 480;
-int oldx = -1, oldy = -1;
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+static void psplot_move(int x, int y)
+{
+  printf("%d %d M\n", x, psplot_height - y);
+}
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+static void psplot_draw(int x, int y)
+{
+  printf("%d %d L\n", x, psplot_height - y);
+}
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+static void psplot_dot(int x, int y)
+{
+  printf("%d %d P\n", x, psplot_height - y);
+}
 
 /* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
 
@@ -46,30 +67,32 @@ newpath\n";
   psplot_width = width;
   psplot_height = height;
   printf(psheader, width, height);
+  /* What was zero before any inversion is the background, which is
+   * the paper and is never drawn.
+   */
+  vecplot_init(psplot_move, psplot_draw, psplot_dot,
+               plot_inverse ? levels - 1 : 0);
 }
 
 /* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
 
 void psplot_point(int i, int j, int val)
 {
-  printf("%d %d P\n", i, psplot_height - j);
-  oldx = oldy = -1;
+  vecplot_point(i, j, val);
 }
 
 /* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
 
 void psplot_line(int i, int j, int k, int l, int val)
 {
-  if(oldx != i || oldy != j)
-    printf("%d %d M\n", i, psplot_height - j);
-  printf("%d %d L\n", k, psplot_height - l);
-  oldx = k; oldy = l;
+  vecplot_line(i, j, k, l, val);
 }
 
 /* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
 
 void psplot_finish(void)
 {
+  vecplot_finish();
   printf("stroke\ngrestore\nend\nshowpage\n");
   printf("%%%%Trailer\n");
 }
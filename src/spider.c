@@ -11,7 +11,7 @@
 int width = 640, height = 480, maxit = 160;
 int levels = 16, rev = 0, box = 0, idiv = 1;
 double ulx = -2.4, uly = 1.4, lly = -1.4, bulx, buly, blly, bail = 16.0;
-char *term = NULL;
+char *term = NULL, *precision = "double";
 
 char help_string[] = "\
 \n";
@@ -31,50 +31,73 @@ OPTION options[] = {
   { "-blly",   OPT_DOUBLE,  &blly,   "box's lower-left y-coordinate"  },
   { "-idiv",   OPT_INT,     &idiv,   "iteration divisor"              },
   { "-rev",    OPT_SWITCH,  &rev,    "reverse all colors but first"   },
+  { "-precision", OPT_STRING, &precision,
+    "float, double, dd, or auto" },
   { "-term",   OPT_STRING,  &term,   "how to plot points"             },
   { NULL,      OPT_NULL,    NULL,    NULL                             }
 };
 
 /* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
 
-int main(int argc, char **argv)
-{
-  int i, j, k;
-  double a, b, inc, binc, u, v, w, x, y, ca, cb;
-
-  get_options(argc, argv, options, help_string);
-  plot_init(width, height, levels, term);
-
 /*
         c(0) = z(0) = pixel;
         z(n+1) = z(n)^2 + c(n);
         c(n+1) = c(n)/2 + z(n+1);
 */
 
+#include "precision.c"
+
+#define ESCAPE_INIT(P, l) \
+  ca[l] = za[l]; \
+  cb[l] = zb[l]
+
+#define ESCAPE_STEP(P, l) \
+  u[l] = P ## _sqr(za[l]); \
+  v[l] = P ## _sqr(zb[l]); \
+  zb[l] = P ## _add(P ## _twice(P ## _mul(za[l], zb[l])), cb[l]); \
+  za[l] = P ## _add(P ## _sub(u[l], v[l]), ca[l]); \
+  ca[l] = P ## _add(P ## _half(ca[l]), za[l]); \
+  cb[l] = P ## _add(P ## _half(cb[l]), zb[l])
+
+ESCAPE_KERNEL(escape_flt, float, flt, 16)
+ESCAPE_KERNEL(escape_dbl, double, dbl, 8)
+ESCAPE_KERNEL(escape_dd, DD, dd, 1)
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+int main(int argc, char **argv)
+{
+  int i, j, k, *row;
+  double inc, binc, scale;
+  ESCAPEFUNC escape;
+
+  get_options(argc, argv, options, help_string);
+
   inc = (uly - lly) / (height - 1);
-  for(j = 0, b = uly; j < height; j++, b -= inc) {
-    for(i = 0, a = ulx; i < width; i++, a += inc) {
-      x = ca = a;
-      y = cb = b;
-      for(k = 1; k <= maxit; k++) {
-        u = x * x;
-        v = y * y;
-        w = 2.0 * x * y;
-        x = u - v + ca;
-        y = w + cb;
-        ca = 0.5 * ca + x;
-        cb = 0.5 * cb + y;
-        if(u + v > bail) {
-          if(rev)
-            plot_point(i, j, -((k / idiv + (k % idiv) * (levels / idiv)) %
-                               levels) + levels - 1);
-          else
-            plot_point(i, j, (k / idiv + (k % idiv) *
-                              (levels / idiv)) % levels);
-          break;
-        }
+  scale = MAX(MAX(fabs(ulx), fabs(ulx + (width - 1) * inc)),
+              MAX(fabs(uly), fabs(lly)));
+  scale = MAX(scale, sqrt(bail));
+  switch(get_precision(precision, inc, scale)) {
+    case PREC_FLOAT: escape = escape_flt; break;
+    case PREC_DD:    escape = escape_dd;  break;
+    default:         escape = escape_dbl; break;
+  }
+  plot_init(width, height, levels, term);
+
+  row = xmalloc(sizeof(int) * width);
+  for(j = 0; j < height; j++) {
+    escape(ulx, uly, inc, 0.0, 0.0, 0, 1, j, width, row);
+    for(i = 0; i < width; i++)
+      if((k = row[i]) != 0) {
+        if(rev)
+          plot_point(i, j, -((k / idiv + (k % idiv) * (levels / idiv)) %
+                             levels) + levels - 1);
+        else
+          plot_point(i, j, (k / idiv + (k % idiv) *
+                            (levels / idiv)) % levels);
       }
-  } }
+  }
+  free(row);
 
   if(box > 0) {
     binc = (buly - blly) / (height - 1);
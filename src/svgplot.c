@@ -0,0 +1,131 @@
+
+/* NAME
+ *   svgplot.c
+ * PURPOSE
+ *   Plot routines to emit an SVG image to stdout.  Everything is passed
+ *   through the segment simplifier in vecplot.c and written as paths
+ *   with relative coordinates, with horizontal and vertical moves
+ *   abbreviated, which keeps the files small.
+ */
+
+#include "misc.h"
+
+/* The number of commands to put in one path element before starting
+   another, which keeps the lines of the file to a reasonable length. */
+
+#define SVG_PATHLEN 64
+
+int svgplot_levels = 2, svgplot_width = 640, svgplot_height = 480;
+
+/* The pen position and the number of commands in the open path, which
+   is zero if no path is open. */
+
+static int svg_x, svg_y, svg_count = 0;
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+/* Start a new path if the open one is full, or if there is none.  New
+   paths always start with an absolute move. */
+
+static void svgplot_path(int x, int y)
+{
+  if(svg_count >= SVG_PATHLEN) {
+    printf("\"/>\n");
+    svg_count = 0;
+  }
+  if(svg_count == 0) {
+    printf("<path d=\"M%d %d", x, y);
+    svg_x = x; svg_y = y;
+    svg_count = 1;
+  }
+}
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+static void svgplot_move(int x, int y)
+{
+  if(svg_count == 0 || svg_count >= SVG_PATHLEN)
+    svgplot_path(x, y);
+  else {
+    printf("m%d %d", x - svg_x, y - svg_y);
+    svg_x = x; svg_y = y;
+    svg_count++;
+  }
+}
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+static void svgplot_draw(int x, int y)
+{
+  /* A draw must continue from the pen, so a full path is closed and
+   * a new one starts at the pen.
+   */
+  if(svg_count >= SVG_PATHLEN)
+    svgplot_path(svg_x, svg_y);
+  if(x == svg_x)
+    printf("v%d", y - svg_y);
+  else if(y == svg_y)
+    printf("h%d", x - svg_x);
+  else
+    printf("l%d %d", x - svg_x, y - svg_y);
+  svg_x = x; svg_y = y;
+  svg_count++;
+}
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+/* A point is a path of zero length, which the square line caps turn
+   into a pixel sized square. */
+
+static void svgplot_dot(int x, int y)
+{
+  svgplot_move(x, y);
+  printf("h0");
+}
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+void svgplot_init(int width, int height, int levels)
+{
+  svgplot_levels = levels;
+  svgplot_width = width;
+  svgplot_height = height;
+  printf("<?xml version=\"1.0\"?>\n");
+  printf("<svg xmlns=\"http://www.w3.org/2000/svg\" width=\"%d\" "
+         "height=\"%d\" viewBox=\"0 0 %d %d\">\n",
+         width, height, width, height);
+  printf("<g fill=\"none\" stroke=\"black\" stroke-width=\"1\" "
+         "stroke-linecap=\"square\" transform=\"translate(0.5 0.5)\">\n");
+  svg_count = 0;
+  /* What was zero before any inversion is the background, which is
+   * the paper and is never drawn.
+   */
+  vecplot_init(svgplot_move, svgplot_draw, svgplot_dot,
+               plot_inverse ? levels - 1 : 0);
+}
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+void svgplot_point(int i, int j, int val)
+{
+  vecplot_point(i, j, val);
+}
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+void svgplot_line(int i, int j, int k, int l, int val)
+{
+  vecplot_line(i, j, k, l, val);
+}
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+void svgplot_finish(void)
+{
+  vecplot_finish();
+  if(svg_count > 0)
+    printf("\"/>\n");
+  printf("</g>\n</svg>\n");
+}
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
@@ -0,0 +1,206 @@
+
+/* NAME
+ *   vecplot.c
+ * PURPOSE
+ *   A segment simplifier shared by the vector plot drivers.  Lines
+ *   and points are passed through vecplot_line() and vecplot_point(),
+ *   and come out as calls to the driver's move, draw, and dot routines
+ *   with as few pen movements as possible:
+ *
+ *   Segments that have already been drawn are dropped.  Every segment
+ *   is remembered in a hash table, so this works no matter how far
+ *   apart the two copies are.
+ *
+ *   A segment that continues the current run of segments in the same
+ *   direction is merged into it, so a straight line that is drawn in
+ *   many pieces is written once.
+ *
+ *   A segment that starts where the pen is only needs a draw.  A
+ *   segment of zero length is dropped if it touches the end of what
+ *   was just drawn, and is treated as a point otherwise.
+ *
+ *   Segments may be given in either direction.
+ *
+ *   Lines and points in the background color, which is given to
+ *   vecplot_init(), are dropped before any of this, since the paper
+ *   already is the background.  Otherwise, every program would start
+ *   by painting the whole page black with plot_set_all().
+ */
+
+#include "misc.h"
+
+/* The driver's output routines. */
+
+static void (*vec_move)(int x, int y);
+static void (*vec_draw)(int x, int y);
+static void (*vec_dot)(int x, int y);
+static int vec_background;
+
+/* The current run of collinear segments goes from (runx0, runy0) to
+   (runx1, runy1), and is empty if haverun is zero.  The pen is at
+   (penx, peny), or nowhere if havepen is zero. */
+
+static int runx0, runy0, runx1, runy1, haverun = 0;
+static int penx, peny, havepen = 0;
+
+/* Open addressing hash table of segments, with each entry holding
+   four coordinates.  The table is doubled when it gets half full. */
+
+static int *vec_table = NULL, vec_size = 0, vec_used = 0;
+
+#define VEC_EMPTY (-0x7fffffff)
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+static unsigned long vec_hash(int *s)
+{
+  unsigned long h;
+  int i;
+
+  for(i = 0, h = 2166136261UL; i < 4; i++)
+    h = (h ^ (unsigned long) (unsigned) s[i]) * 16777619UL;
+  return(h ^ (h >> 15));
+}
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+/* Put the segment S in the table, unless it is already there.  Returns
+   1 if it was new. */
+
+static int vec_insert(int *s)
+{
+  int *old, oldsize, i, j;
+  unsigned long h;
+
+  if(2 * (vec_used + 1) > vec_size) {
+    old = vec_table;
+    oldsize = vec_size;
+    vec_size = (vec_size == 0) ? 1024 : 2 * vec_size;
+    vec_table = xmalloc(sizeof(int) * 4 * vec_size);
+    for(i = 0; i < vec_size; i++)
+      vec_table[4 * i] = VEC_EMPTY;
+    vec_used = 0;
+    for(i = 0; i < oldsize; i++)
+      if(old[4 * i] != VEC_EMPTY)
+        vec_insert(old + 4 * i);
+    if(old) free(old);
+  }
+  h = vec_hash(s);
+  for(i = h & (vec_size - 1); vec_table[4 * i] != VEC_EMPTY;
+      i = (i + 1) & (vec_size - 1))
+    if(vec_table[4 * i] == s[0] && vec_table[4 * i + 1] == s[1] &&
+       vec_table[4 * i + 2] == s[2] && vec_table[4 * i + 3] == s[3])
+      return(0);
+  for(j = 0; j < 4; j++)
+    vec_table[4 * i + j] = s[j];
+  vec_used++;
+  return(1);
+}
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+/* Write out the current run. */
+
+static void vec_flush_run(void)
+{
+  if(!haverun) return;
+  if(!havepen || penx != runx0 || peny != runy0)
+    vec_move(runx0, runy0);
+  vec_draw(runx1, runy1);
+  penx = runx1; peny = runy1;
+  havepen = 1;
+  haverun = 0;
+}
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+void vecplot_init(void (*move)(int x, int y), void (*draw)(int x, int y),
+                  void (*dot)(int x, int y), int background)
+{
+  vec_move = move;
+  vec_draw = draw;
+  vec_dot = dot;
+  vec_background = background;
+  haverun = havepen = 0;
+  if(vec_table) free(vec_table);
+  vec_table = NULL;
+  vec_size = vec_used = 0;
+}
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+void vecplot_point(int x, int y, int val)
+{
+  int s[4];
+
+  if(val == vec_background) return;
+  s[0] = s[2] = x;
+  s[1] = s[3] = y;
+  if(!vec_insert(s)) return;
+  vec_flush_run();
+  vec_dot(x, y);
+  havepen = 0;
+}
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+void vecplot_line(int x1, int y1, int x2, int y2, int val)
+{
+  int s[4], t;
+
+  if(val == vec_background) return;
+
+  /* A segment of zero length is dropped if it is at the end of what
+   * has just been drawn, and is a point otherwise.
+   */
+  if(x1 == x2 && y1 == y2) {
+    if(haverun ? (x1 != runx1 || y1 != runy1) :
+       (!havepen || x1 != penx || y1 != peny))
+      vecplot_point(x1, y1, val);
+    return;
+  }
+
+  /* Look the segment up with its endpoints in a fixed order. */
+  if(x1 < x2 || (x1 == x2 && y1 < y2)) {
+    s[0] = x1; s[1] = y1; s[2] = x2; s[3] = y2;
+  }
+  else {
+    s[0] = x2; s[1] = y2; s[2] = x1; s[3] = y1;
+  }
+  if(!vec_insert(s)) return;
+
+  /* Turn the segment around if it ends where the run ends. */
+  if(haverun && x2 == runx1 && y2 == runy1) {
+    t = x1; x1 = x2; x2 = t;
+    t = y1; y1 = y2; y2 = t;
+  }
+
+  /* Extend the run if the segment continues it in the same direction,
+   * which is the case if the cross product of the two is zero and
+   * the dot product is positive.
+   */
+  if(haverun && x1 == runx1 && y1 == runy1 &&
+     (double) (runx1 - runx0) * (y2 - y1) ==
+     (double) (runy1 - runy0) * (x2 - x1) &&
+     (double) (runx1 - runx0) * (x2 - x1) +
+     (double) (runy1 - runy0) * (y2 - y1) > 0) {
+    runx1 = x2; runy1 = y2;
+    return;
+  }
+  vec_flush_run();
+  runx0 = x1; runy0 = y1;
+  runx1 = x2; runy1 = y2;
+  haverun = 1;
+}
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+void vecplot_finish(void)
+{
+  vec_flush_run();
+  if(vec_table) free(vec_table);
+  vec_table = NULL;
+  vec_size = vec_used = 0;
+}
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
@@ -236,3 +236,10 @@ void X11plot_finish(void)
 }
 
 /* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+void X11plot_frame(void)
+{
+  XFlush(x_display);
+}
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
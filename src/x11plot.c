@@ -207,3 +207,10 @@ void x11plot_finish(void)
 }
 
 /* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+void x11plot_frame(void)
+{
+  XFlush(x_display);
+}
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */